@@ -0,0 +1,230 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Types whose objects can be moved to other memory with `memcpy`, after which the old bytes are
+// dropped without running the destructor
+//
+// Every trivially copyable type qualifies. Classes that only hold pointers and never point into
+// themselves, such as the smart pointers of this library, opt in by specializing the trait.
+template <typename T>
+struct IsTriviallyRelocatable : std::is_trivially_copyable<T> {};
+
+template <typename T>
+inline constexpr bool kIsTriviallyRelocatable = IsTriviallyRelocatable<T>::value;
+
+// Growable array that lets `realloc` move trivially relocatable elements when it grows
+//
+// `realloc` extends the buffer in place when it can and moves big buffers by remapping their
+// pages, so the elements are often not copied at all. Other element types are moved one by one,
+// or copied if their move constructor may throw, like `std::vector` does.
+template <typename T>
+class RelocatingVector {
+public:
+    RelocatingVector() = default;
+
+    RelocatingVector(const RelocatingVector&) = delete;
+    RelocatingVector& operator=(const RelocatingVector&) = delete;
+
+    RelocatingVector(RelocatingVector&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)),
+          size_(std::exchange(other.size_, 0)),
+          capacity_(std::exchange(other.capacity_, 0)) {
+    }
+
+    RelocatingVector& operator=(RelocatingVector&& other) noexcept {
+        RelocatingVector(std::move(other)).Swap(*this);
+        return *this;
+    }
+
+    ~RelocatingVector() {
+        Clear();
+        Deallocate(data_, capacity_);
+    }
+
+    template <typename... Args>
+    T& EmplaceBack(Args&&... args) {
+        if (size_ == capacity_) {
+            return GrowAndEmplace(std::forward<Args>(args)...);
+        }
+        new (data_ + size_) T(std::forward<Args>(args)...);
+        return data_[size_++];
+    }
+
+    void PushBack(const T& value) {
+        EmplaceBack(value);
+    }
+
+    void PushBack(T&& value) {
+        EmplaceBack(std::move(value));
+    }
+
+    void PopBack() {
+        data_[--size_].~T();
+    }
+
+    void Reserve(size_t capacity) {
+        if (capacity > capacity_) {
+            Reallocate(capacity);
+        }
+    }
+
+    void Clear() {
+        std::destroy_n(data_, size_);
+        size_ = 0;
+    }
+
+    void Swap(RelocatingVector& other) noexcept {
+        std::swap(data_, other.data_);
+        std::swap(size_, other.size_);
+        std::swap(capacity_, other.capacity_);
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+    size_t Capacity() const {
+        return capacity_;
+    }
+
+    bool Empty() const {
+        return size_ == 0;
+    }
+
+    T& operator[](size_t index) {
+        return data_[index];
+    }
+
+    const T& operator[](size_t index) const {
+        return data_[index];
+    }
+
+    T* begin() {
+        return data_;
+    }
+
+    T* end() {
+        return data_ + size_;
+    }
+
+    const T* begin() const {
+        return data_;
+    }
+
+    const T* end() const {
+        return data_ + size_;
+    }
+
+private:
+    static constexpr bool kUseRealloc =
+        kIsTriviallyRelocatable<T> && alignof(T) <= alignof(std::max_align_t);
+
+    static T* Allocate(size_t capacity) {
+        if constexpr (kUseRealloc) {
+            return Reallocate(nullptr, capacity);
+        } else {
+            return std::allocator<T>().allocate(capacity);
+        }
+    }
+
+    static void Deallocate(T* data, size_t capacity) {
+        if constexpr (kUseRealloc) {
+            std::free(data);
+        } else if (data != nullptr) {
+            std::allocator<T>().deallocate(data, capacity);
+        }
+    }
+
+    static T* Reallocate(T* data, size_t capacity) {
+        if (capacity > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        void* memory = std::realloc(static_cast<void*>(data), capacity * sizeof(T));
+        if (memory == nullptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<T*>(memory);
+    }
+
+    // Moves the elements to a buffer of `capacity` elements; leaves the vector as it was if this
+    // throws
+    void Reallocate(size_t capacity) {
+        if constexpr (kUseRealloc) {
+            data_ = Reallocate(data_, capacity);
+        } else {
+            T* data = Allocate(capacity);
+            try {
+                MoveElements(data);
+            } catch (...) {
+                Deallocate(data, capacity);
+                throw;
+            }
+            Deallocate(data_, capacity_);
+            data_ = data;
+        }
+        capacity_ = capacity;
+    }
+
+    // The arguments may refer to the elements, so the new one is made before the buffer moves
+    template <typename... Args>
+    T& GrowAndEmplace(Args&&... args) {
+        size_t capacity = capacity_ == 0 ? 1 : 2 * capacity_;
+        if constexpr (kUseRealloc) {
+            // Made aside and then relocated into place
+            alignas(T) unsigned char value[sizeof(T)];
+            new (value) T(std::forward<Args>(args)...);
+            try {
+                Reallocate(capacity);
+            } catch (...) {
+                std::launder(reinterpret_cast<T*>(value))->~T();
+                throw;
+            }
+            std::memcpy(static_cast<void*>(data_ + size_), value, sizeof(T));
+        } else {
+            T* data = Allocate(capacity);
+            try {
+                new (data + size_) T(std::forward<Args>(args)...);
+            } catch (...) {
+                Deallocate(data, capacity);
+                throw;
+            }
+            try {
+                MoveElements(data);
+            } catch (...) {
+                data[size_].~T();
+                Deallocate(data, capacity);
+                throw;
+            }
+            Deallocate(data_, capacity_);
+            data_ = data;
+            capacity_ = capacity;
+        }
+        return data_[size_++];
+    }
+
+    // Moves the elements to `data` and destroys the old ones, or destroys the new ones on failure
+    void MoveElements(T* data) {
+        size_t moved = 0;
+        try {
+            for (; moved < size_; ++moved) {
+                new (data + moved) T(std::move_if_noexcept(data_[moved]));
+            }
+        } catch (...) {
+            std::destroy_n(data, moved);
+            throw;
+        }
+        std::destroy_n(data_, size_);
+    }
+
+    T* data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+};
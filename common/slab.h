@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Size-class slab allocator with per-thread magazines
+//
+// Requests of up to `kMaxSize` bytes are rounded up to a multiple of `kGranularity` and served
+// from the calling thread's free list for that size class. An empty list takes a magazine of
+// freed objects from the global depot, which cuts new slabs of `kSlabSize` bytes into magazines
+// when it runs dry; a list that grows past two magazines hands its older half back. Slabs are
+// never returned to the system. Bigger requests go straight to `::operator new`.
+class SlabAllocator {
+public:
+    static constexpr size_t kGranularity = 16;
+    static constexpr size_t kMaxSize = 512;
+    static constexpr size_t kMagazineSize = 64;
+    static constexpr size_t kSlabSize = 64 * 1024;
+
+    static void* Allocate(size_t size) {
+        if (size > kMaxSize) {
+            return ::operator new(size);
+        }
+        size_t size_class = ClassOf(size);
+        if (ThreadCache::gone) {
+            return GetDepot().AllocateOne(size_class);
+        }
+        return GetThreadCache().Pop(size_class);
+    }
+
+    static void Deallocate(void* ptr, size_t size) {
+        if (size > kMaxSize) {
+            ::operator delete(ptr);
+            return;
+        }
+        size_t size_class = ClassOf(size);
+        if (ThreadCache::gone) {
+            GetDepot().Put({static_cast<Node*>(ptr), 1}, size_class);
+            return;
+        }
+        GetThreadCache().Push(size_class, ptr);
+    }
+
+private:
+    static constexpr size_t kClasses = kMaxSize / kGranularity;
+
+    struct Node {
+        Node* next;
+    };
+
+    struct Magazine {
+        Node* head = nullptr;
+        size_t size = 0;
+    };
+
+    static size_t ClassOf(size_t size) {
+        return (std::max<size_t>(size, 1) + kGranularity - 1) / kGranularity - 1;
+    }
+
+    // Full magazines shared by all threads
+    class Depot {
+    public:
+        Magazine Take(size_t size_class) {
+            std::lock_guard guard(mutex_);
+            auto& magazines = magazines_[size_class];
+            if (magazines.empty()) {
+                Carve(size_class, magazines);
+            }
+            Magazine magazine = magazines.back();
+            magazines.pop_back();
+            return magazine;
+        }
+
+        void Put(Magazine magazine, size_t size_class) {
+            std::lock_guard guard(mutex_);
+            magazines_[size_class].push_back(magazine);
+        }
+
+        // For threads whose cache is already destroyed
+        void* AllocateOne(size_t size_class) {
+            Magazine magazine = Take(size_class);
+            Node* node = magazine.head;
+            if (magazine.size > 1) {
+                Put({node->next, magazine.size - 1}, size_class);
+            }
+            return node;
+        }
+
+    private:
+        // Cuts a new slab into magazines
+        static void Carve(size_t size_class, std::vector<Magazine>& magazines) {
+            size_t object_size = (size_class + 1) * kGranularity;
+            auto* slab = static_cast<char*>(::operator new(kSlabSize));
+            Magazine magazine;
+            for (size_t offset = 0; offset + object_size <= kSlabSize; offset += object_size) {
+                auto* node = reinterpret_cast<Node*>(slab + offset);
+                node->next = magazine.head;
+                magazine.head = node;
+                if (++magazine.size == kMagazineSize) {
+                    magazines.push_back(std::exchange(magazine, {}));
+                }
+            }
+            if (magazine.size > 0) {
+                magazines.push_back(magazine);
+            }
+        }
+
+        std::mutex mutex_;
+        std::vector<Magazine> magazines_[kClasses];
+    };
+
+    // Free lists of one thread; needs no synchronization
+    class ThreadCache {
+    public:
+        ~ThreadCache() {
+            gone = true;
+            for (size_t size_class = 0; size_class < kClasses; ++size_class) {
+                if (lists_[size_class].size > 0) {
+                    GetDepot().Put(lists_[size_class], size_class);
+                }
+            }
+        }
+
+        void* Pop(size_t size_class) {
+            Magazine& list = lists_[size_class];
+            if (list.head == nullptr) {
+                list = GetDepot().Take(size_class);
+            }
+            Node* node = list.head;
+            list.head = node->next;
+            --list.size;
+            return node;
+        }
+
+        void Push(size_t size_class, void* ptr) {
+            Magazine& list = lists_[size_class];
+            auto* node = static_cast<Node*>(ptr);
+            node->next = list.head;
+            list.head = node;
+            if (++list.size > 2 * kMagazineSize) {
+                // Keep the recently freed objects, they are likely still in the cache
+                Node* last = list.head;
+                for (size_t i = 1; i < kMagazineSize; ++i) {
+                    last = last->next;
+                }
+                GetDepot().Put({last->next, list.size - kMagazineSize}, size_class);
+                last->next = nullptr;
+                list.size = kMagazineSize;
+            }
+        }
+
+        // Set once the thread has destroyed its cache, for objects freed even later
+        inline static thread_local bool gone = false;
+
+    private:
+        Magazine lists_[kClasses];
+    };
+
+    // Never destroyed, so threads that outlive `main` can still free into it
+    static Depot& GetDepot() {
+        static Depot* depot = new Depot;
+        return *depot;
+    }
+
+    static ThreadCache& GetThreadCache() {
+        static thread_local ThreadCache cache;
+        return cache;
+    }
+};
+
+// Base for classes whose objects come from `SlabAllocator`
+struct SlabAllocated {
+    static void* operator new(size_t size) {
+        return SlabAllocator::Allocate(size);
+    }
+
+    static void operator delete(void* ptr, size_t size) {
+        SlabAllocator::Deallocate(ptr, size);
+    }
+
+    // Over-aligned objects keep the global allocator
+    static void* operator new(size_t size, std::align_val_t align) {
+        return ::operator new(size, align);
+    }
+
+    static void operator delete(void* ptr, size_t size, std::align_val_t align) {
+        ::operator delete(ptr, size, align);
+    }
+
+    // Declaring the other forms hides the global placement new
+    static void* operator new(size_t, void* place) noexcept {
+        return place;
+    }
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <common/relocation.h>
+
 #include <cstddef>  // for std::nullptr_t
 #include <utility>  // for std::exchange / std::swap
 
@@ -28,6 +30,8 @@ struct DefaultDelete {
     }
 };
 
+// Classes that also derive from `SlabAllocated` take their objects from `SlabAllocator`,
+// `MakeIntrusive` included
 template <typename Derived, typename Counter, typename Deleter>
 class RefCounted {
 public:
@@ -66,7 +70,7 @@ class IntrusivePtr {
 public:
     // Constructors
     IntrusivePtr() = default;
-    IntrusivePtr(std::nullptr_t) : ptr_(nullptr) {
+    IntrusivePtr(std::nullptr_t) noexcept : ptr_(nullptr) {
     }
     IntrusivePtr(T* ptr) : ptr_(ptr) {
         if (ptr_ != nullptr) {
@@ -81,12 +85,9 @@ public:
         }
     }
 
+    // Moves take the reference over and leave the counter alone
     template <typename Y>
-    IntrusivePtr(IntrusivePtr<Y>&& other) : ptr_(std::move(other.ptr_)) {
-        if (ptr_ != nullptr) {
-            ptr_->IncRef();
-        }
-        other.Reset();
+    IntrusivePtr(IntrusivePtr<Y>&& other) noexcept : ptr_(std::exchange(other.ptr_, nullptr)) {
     }
 
     IntrusivePtr(const IntrusivePtr& other) : ptr_(other.ptr_) {
@@ -94,11 +95,7 @@ public:
             ptr_->IncRef();
         }
     }
-    IntrusivePtr(IntrusivePtr&& other) : ptr_(std::move(other.ptr_)) {
-        if (ptr_ != nullptr) {
-            ptr_->IncRef();
-        }
-        other.Reset();
+    IntrusivePtr(IntrusivePtr&& other) noexcept : ptr_(std::exchange(other.ptr_, nullptr)) {
     }
 
     // `operator=`-s
@@ -116,18 +113,8 @@ public:
         return *this;
     }
 
-    IntrusivePtr& operator=(IntrusivePtr&& other) {
-        if (ptr_ == other.ptr_) {
-            return *this;
-        }
-        if (ptr_ != nullptr) {
-            ptr_->DecRef();
-        }
-        ptr_ = std::move(other.ptr_);
-        if (ptr_ != nullptr) {
-            ptr_->IncRef();
-        }
-        other.Reset();
+    IntrusivePtr& operator=(IntrusivePtr&& other) noexcept {
+        IntrusivePtr(std::move(other)).Swap(*this);
         return *this;
     }
 
@@ -154,7 +141,7 @@ public:
             ptr_->IncRef();
         }
     }
-    void Swap(IntrusivePtr& other) {
+    void Swap(IntrusivePtr& other) noexcept {
         std::swap(ptr_, other.ptr_);
     }
 
@@ -182,6 +169,9 @@ private:
     T* ptr_ = nullptr;
 };
 
+template <typename T>
+struct IsTriviallyRelocatable<IntrusivePtr<T>> : std::true_type {};
+
 template <typename T, typename... Args>
 IntrusivePtr<T> MakeIntrusive(Args&&... args) {
     IntrusivePtr<T> res = new T(std::forward<Args>(args)...);
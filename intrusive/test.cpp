@@ -386,3 +386,51 @@ TEST_CASE("Object pool") {
         REQUIRE(strs.NumInUse() == 1);
     }
 }
+
+////////////////////////////////////////////////////////////////////////////////
+
+class CountingCounter : public SimpleCounter {
+public:
+    size_t IncRef() {
+        ++increments;
+        return SimpleCounter::IncRef();
+    }
+
+    size_t DecRef() {
+        ++decrements;
+        return SimpleCounter::DecRef();
+    }
+
+    inline static int increments = 0;
+    inline static int decrements = 0;
+};
+
+struct Counted : RefCounted<Counted, CountingCounter, DefaultDelete> {};
+
+struct DerivedCounted : Counted {};
+
+TEST_CASE("Moves leave the counter alone") {
+    IntrusivePtr<DerivedCounted> derived(new DerivedCounted);
+    IntrusivePtr<Counted> a(new Counted);
+    CountingCounter::increments = 0;
+    CountingCounter::decrements = 0;
+
+    IntrusivePtr<Counted> b = std::move(a);
+    IntrusivePtr<Counted> c(std::move(derived));
+    b = std::move(b);  // NOLINT
+    a = std::move(b);
+    std::vector<IntrusivePtr<Counted>> ptrs;
+    ptrs.push_back(std::move(a));
+    ptrs.push_back(std::move(c));
+    ptrs.reserve(100);
+    std::swap(ptrs[0], ptrs[1]);
+
+    REQUIRE(CountingCounter::increments == 0);
+    REQUIRE(CountingCounter::decrements == 0);
+    REQUIRE(ptrs[0].UseCount() == 1);
+    REQUIRE(ptrs[1].UseCount() == 1);
+    REQUIRE(!a);
+    REQUIRE(!b);
+    REQUIRE(!c);
+    REQUIRE(!derived);
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+
+// User-space addresses must fit in 48 bits with the top bits clear. x86-64 and AArch64 give that
+// unless the process asks for 57-bit addresses or the heap tags the top byte of its pointers.
+#if !defined(__x86_64__) && !defined(_M_X64) && !defined(__aarch64__) && !defined(_M_ARM64)
+#error "AtomicSharedPtr packs 48-bit pointers and does not support this architecture"
+#endif
+#if defined(__SANITIZE_HWADDRESS__)
+#error "AtomicSharedPtr cannot pack the tagged pointers of HWASan"
+#endif
+#if defined(__has_feature)
+#if __has_feature(hwaddress_sanitizer)
+#error "AtomicSharedPtr cannot pack the tagged pointers of HWASan"
+#endif
+#endif
+
+// Lock-free `SharedPtr` cell with split reference counting
+//
+// Every stored value lives in a node, and the cell keeps one word: the node address in the low
+// 48 bits and the number of readers currently copying out of that node in the high 16 bits. A
+// reader bumps the high bits, copies the `SharedPtr` and then either gives its count back to the
+// cell or, if a writer has replaced the node meanwhile, to the node's own counter. Writers move the
+// readers' count to the old node when they swap it out, and whoever brings the node's counter to
+// zero frees it.
+//
+// `Load` never takes a lock and never waits for writers; `Store` and `Exchange` are one atomic
+// exchange plus the allocation of the new node.
+template <typename T>
+class AtomicSharedPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    AtomicSharedPtr() = default;
+
+    AtomicSharedPtr(SharedPtr<T> desired) : word_(Pack(MakeNode(std::move(desired)))) {
+    }
+
+    AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+    AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~AtomicSharedPtr() {
+        delete Unpack(word_.load(std::memory_order_acquire));
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Store(SharedPtr<T> desired) {
+        Exchange(std::move(desired));
+    }
+
+    SharedPtr<T> Exchange(SharedPtr<T> desired) {
+        Node* replacement = MakeNode(std::move(desired));
+        uint64_t old = word_.exchange(Pack(replacement), std::memory_order_acq_rel);
+        Node* node = Unpack(old);
+        if (node == nullptr) {
+            return SharedPtr<T>();
+        }
+        // Readers may still be copying out of the node, so it is only safe to copy here too
+        SharedPtr<T> result = node->value;
+        Retire(node, old >> kPointerBits);
+        return result;
+    }
+
+    // Replaces the value if it still shares ownership with `expected` and points to the same
+    // object; otherwise loads the current value into `expected`
+    bool CompareExchange(SharedPtr<T>& expected, SharedPtr<T> desired) {
+        Node* replacement = MakeNode(std::move(desired));
+        while (true) {
+            uint64_t current = Acquire();
+            Node* node = Unpack(current);
+            if (!Equivalent(node, expected)) {
+                expected = node != nullptr ? node->value : SharedPtr<T>();
+                Release(node);
+                delete replacement;
+                return false;
+            }
+
+            // Readers may come and go in the high bits while the node stays the same
+            current += kOneReader;
+            while (Unpack(current) == node) {
+                if (word_.compare_exchange_weak(current, Pack(replacement),
+                                                std::memory_order_acq_rel,
+                                                std::memory_order_relaxed)) {
+                    if (node != nullptr) {
+                        Retire(node, current >> kPointerBits);
+                    }
+                    Release(node);
+                    return true;
+                }
+            }
+            Release(node);
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    SharedPtr<T> Load() const {
+        if (Unpack(word_.load(std::memory_order_relaxed)) == nullptr) {
+            return SharedPtr<T>();
+        }
+        Node* node = Unpack(Acquire());
+        SharedPtr<T> result = node != nullptr ? node->value : SharedPtr<T>();
+        Release(node);
+        return result;
+    }
+
+    static constexpr bool IsLockFree() {
+        return std::atomic<uint64_t>::is_always_lock_free;
+    }
+
+private:
+    struct Node {
+        SharedPtr<T> value;
+        // Readers that finished after the node was swapped out minus readers that were inside it
+        // at that moment; the node dies when this returns to zero
+        std::atomic<int64_t> retired_readers = 0;
+    };
+
+    static_assert(sizeof(void*) == sizeof(uint64_t), "Split counts need 64-bit pointers");
+
+    static constexpr int kPointerBits = 48;
+    static constexpr uint64_t kPointerMask = (uint64_t{1} << kPointerBits) - 1;
+    static constexpr uint64_t kOneReader = uint64_t{1} << kPointerBits;
+
+    static Node* MakeNode(SharedPtr<T> value) {
+        if (!value) {
+            return nullptr;
+        }
+        auto* node = new Node{std::move(value)};
+        // Catches tagged pointers and addresses above 2^48
+        assert((Pack(node) & ~kPointerMask) == 0);
+        return node;
+    }
+
+    static uint64_t Pack(Node* node) {
+        return reinterpret_cast<uint64_t>(node);
+    }
+
+    static Node* Unpack(uint64_t word) {
+        return reinterpret_cast<Node*>(word & kPointerMask);
+    }
+
+    static bool Equivalent(Node* node, const SharedPtr<T>& expected) {
+        if (node == nullptr) {
+            return !expected;
+        }
+        return node->value.Get() == expected.Get() &&
+               node->value.GetBlock() == expected.GetBlock();
+    }
+
+    // Registers the caller as a reader of the current node
+    uint64_t Acquire() const {
+        return word_.fetch_add(kOneReader, std::memory_order_acquire);
+    }
+
+    void Release(Node* node) const {
+        uint64_t current = word_.load(std::memory_order_relaxed);
+        while (Unpack(current) == node) {
+            if (word_.compare_exchange_weak(current, current - kOneReader,
+                                            std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                return;
+            }
+        }
+        // A writer swapped the node out and handed our count over to it
+        if (node == nullptr) {
+            return;
+        }
+        if (node->retired_readers.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete node;
+        }
+    }
+
+    // Called by the writer that swapped `node` out while `readers` were inside it
+    static void Retire(Node* node, int64_t readers) {
+        if (node->retired_readers.fetch_add(readers, std::memory_order_acq_rel) == -readers) {
+            delete node;
+        }
+    }
+
+    mutable std::atomic<uint64_t> word_ = 0;
+};
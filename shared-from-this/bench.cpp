@@ -0,0 +1,354 @@
+#include "atomic_shared.h"
+#include "biased.h"
+#include "packed.h"
+#include "shared.h"
+#include "side_table.h"
+#include "weak.h"
+
+#include <intrusive/intrusive.h>
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copy + destroy of an owner, single thread
+
+template <typename Counter>
+static void BM_Copy(benchmark::State& state) {
+    auto sp = MakeShared<int, Counter>(42);
+    for (auto _ : state) {
+        SharedPtr<int, Counter> copy(sp);
+        benchmark::DoNotOptimize(copy);
+    }
+}
+BENCHMARK_TEMPLATE(BM_Copy, LocalCounter);
+BENCHMARK_TEMPLATE(BM_Copy, AtomicCounter);
+BENCHMARK_TEMPLATE(BM_Copy, BiasedCounter);
+BENCHMARK_TEMPLATE(BM_Copy, PackedCounter);
+BENCHMARK_TEMPLATE(BM_Copy, SideTableCounter);
+
+template <typename Counter>
+static void BM_WeakCopy(benchmark::State& state) {
+    auto sp = MakeShared<int, Counter>(42);
+    WeakPtr<int, Counter> wp(sp);
+    for (auto _ : state) {
+        WeakPtr<int, Counter> copy(wp);
+        benchmark::DoNotOptimize(copy);
+    }
+}
+BENCHMARK_TEMPLATE(BM_WeakCopy, LocalCounter);
+BENCHMARK_TEMPLATE(BM_WeakCopy, AtomicCounter);
+BENCHMARK_TEMPLATE(BM_WeakCopy, BiasedCounter);
+BENCHMARK_TEMPLATE(BM_WeakCopy, PackedCounter);
+BENCHMARK_TEMPLATE(BM_WeakCopy, SideTableCounter);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Make + last release, single thread
+
+template <typename Counter>
+static void BM_MakeShared(benchmark::State& state) {
+    for (auto _ : state) {
+        auto sp = MakeShared<int, Counter>(42);
+        benchmark::DoNotOptimize(sp);
+    }
+}
+BENCHMARK_TEMPLATE(BM_MakeShared, LocalCounter);
+BENCHMARK_TEMPLATE(BM_MakeShared, AtomicCounter);
+BENCHMARK_TEMPLATE(BM_MakeShared, PackedCounter);
+BENCHMARK_TEMPLATE(BM_MakeShared, SideTableCounter);
+
+template <typename Counter>
+static void BM_FromPointer(benchmark::State& state) {
+    for (auto _ : state) {
+        SharedPtr<int, Counter> sp(new int(42));
+        benchmark::DoNotOptimize(sp);
+    }
+}
+BENCHMARK_TEMPLATE(BM_FromPointer, LocalCounter);
+BENCHMARK_TEMPLATE(BM_FromPointer, AtomicCounter);
+BENCHMARK_TEMPLATE(BM_FromPointer, PackedCounter);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// 256 MiB buffer that is filled right after it is made
+
+static constexpr size_t kBufferSize = size_t{256} << 20;
+
+static void BM_BufferValueInitialized(benchmark::State& state) {
+    for (auto _ : state) {
+        auto buffer = MakeShared<char[]>(kBufferSize);
+        std::memset(buffer.Get(), 1, kBufferSize);
+        benchmark::DoNotOptimize(buffer.Get());
+    }
+    state.SetBytesProcessed(state.iterations() * kBufferSize);
+}
+BENCHMARK(BM_BufferValueInitialized)->Unit(benchmark::kMillisecond);
+
+static void BM_BufferForOverwrite(benchmark::State& state) {
+    for (auto _ : state) {
+        auto buffer = MakeSharedForOverwrite<char[]>(kBufferSize);
+        std::memset(buffer.Get(), 1, kBufferSize);
+        benchmark::DoNotOptimize(buffer.Get());
+    }
+    state.SetBytesProcessed(state.iterations() * kBufferSize);
+}
+BENCHMARK(BM_BufferForOverwrite)->Unit(benchmark::kMillisecond);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Release of 1M sole owners: trivially destructible objects are freed without being destroyed
+
+struct Destructible {
+    Destructible(int value) : value(value) {
+    }
+
+    ~Destructible() {
+        benchmark::DoNotOptimize(value);
+    }
+
+    int value;
+};
+
+template <typename T>
+static void BM_Release(benchmark::State& state) {
+    constexpr int kOwners = 1 << 20;
+    std::vector<SharedPtr<T>> owners;
+    owners.reserve(kOwners);
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (int i = 0; i < kOwners; ++i) {
+            owners.push_back(MakeShared<T>(i));
+        }
+        state.ResumeTiming();
+        owners.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * kOwners);
+}
+BENCHMARK_TEMPLATE(BM_Release, int)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Release, Destructible)->Unit(benchmark::kMillisecond);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Vector of 10M owners grown one by one: `RelocatingVector` lets `realloc` move them, while
+// `std::vector` moves and destroys them one at a time. One in 16 owners is null, the rest share
+// one object.
+
+struct Node : SimpleRefCounted<Node> {};
+
+template <typename Vector, typename Ptr>
+static void Append(Vector& vector, Ptr&& value) {
+    vector.push_back(std::forward<Ptr>(value));
+}
+
+template <typename T, typename Ptr>
+static void Append(RelocatingVector<T>& vector, Ptr&& value) {
+    vector.PushBack(std::forward<Ptr>(value));
+}
+
+template <template <typename...> class Vector, typename Ptr>
+static void BM_Grow(benchmark::State& state) {
+    constexpr int kOwners = 10'000'000;
+    Ptr owner;
+    if constexpr (std::is_same_v<Ptr, IntrusivePtr<Node>>) {
+        owner = MakeIntrusive<Node>();
+    } else {
+        owner = MakeLocalShared<int>(42);
+    }
+    for (auto _ : state) {
+        Vector<Ptr> owners;
+        for (int i = 0; i < kOwners; ++i) {
+            Append(owners, i % 16 == 0 ? Ptr() : owner);
+        }
+        benchmark::DoNotOptimize(owners);
+    }
+    state.SetItemsProcessed(state.iterations() * kOwners);
+}
+BENCHMARK_TEMPLATE(BM_Grow, std::vector, LocalSharedPtr<int>)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Grow, RelocatingVector, LocalSharedPtr<int>)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Grow, std::vector, IntrusivePtr<Node>)->Unit(benchmark::kMillisecond);
+BENCHMARK_TEMPLATE(BM_Grow, RelocatingVector, IntrusivePtr<Node>)->Unit(benchmark::kMillisecond);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Same owner copied from several threads at once
+
+static void BM_AtomicCopyContended(benchmark::State& state) {
+    static SharedPtr<int> sp;
+    if (state.thread_index() == 0) {
+        sp = MakeShared<int>(42);
+    }
+    for (auto _ : state) {
+        SharedPtr<int> copy(sp);
+        benchmark::DoNotOptimize(copy);
+    }
+    if (state.thread_index() == 0) {
+        sp.Reset();
+    }
+}
+BENCHMARK(BM_AtomicCopyContended)->ThreadRange(1, 8)->UseRealTime();
+
+// The thread that made the pointer copies it on every iteration, the others once in 20
+template <typename Counter>
+static void BM_OwnerHeavyCopy(benchmark::State& state) {
+    static SharedPtr<int, Counter> sp;
+    if (state.thread_index() == 0) {
+        sp = MakeShared<int, Counter>(42);
+    }
+    int step = state.thread_index() == 0 ? 1 : 20;
+    int i = 0;
+    for (auto _ : state) {
+        if (++i == step) {
+            i = 0;
+            SharedPtr<int, Counter> copy(sp);
+            benchmark::DoNotOptimize(copy);
+        }
+    }
+    if (state.thread_index() == 0) {
+        sp.Reset();
+    }
+}
+BENCHMARK_TEMPLATE(BM_OwnerHeavyCopy, AtomicCounter)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_OwnerHeavyCopy, BiasedCounter)->ThreadRange(1, 8)->UseRealTime();
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Compact vs isolated `MakeShared` layout
+
+template <typename Layout>
+static SharedPtr<int64_t> MakeWithLayout(int64_t value) {
+    if constexpr (std::is_same_v<Layout, IsolatedLayout>) {
+        return MakeSharedIsolated<int64_t>(value);
+    } else {
+        return MakeShared<int64_t>(value);
+    }
+}
+
+// Thread 0 keeps writing to the object while the others copy the owner: isolated wins
+template <typename Layout>
+static void BM_WriteWhileCopying(benchmark::State& state) {
+    static SharedPtr<int64_t> sp;
+    if (state.thread_index() == 0) {
+        sp = MakeWithLayout<Layout>(0);
+    }
+    for (auto _ : state) {
+        if (state.thread_index() == 0) {
+            benchmark::DoNotOptimize(++*sp);
+        } else {
+            SharedPtr<int64_t> copy(sp);
+            benchmark::DoNotOptimize(copy);
+        }
+    }
+    if (state.thread_index() == 0) {
+        sp.Reset();
+    }
+}
+BENCHMARK_TEMPLATE(BM_WriteWhileCopying, CompactLayout)->ThreadRange(2, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_WriteWhileCopying, IsolatedLayout)->ThreadRange(2, 8)->UseRealTime();
+
+// Reads through many owners that are not shared with anyone: compact touches half the lines
+template <typename Layout>
+static void BM_ReadMany(benchmark::State& state) {
+    std::vector<SharedPtr<int64_t>> values;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        values.push_back(MakeWithLayout<Layout>(i));
+    }
+    for (auto _ : state) {
+        int64_t sum = 0;
+        for (const auto& value : values) {
+            sum += *value + static_cast<int64_t>(value.UseCount());
+        }
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK_TEMPLATE(BM_ReadMany, CompactLayout)->Arg(1 << 10)->Arg(1 << 18);
+BENCHMARK_TEMPLATE(BM_ReadMany, IsolatedLayout)->Arg(1 << 10)->Arg(1 << 18);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// 100k small records made one by one vs in one batch, then read once and dropped
+
+struct Record {
+    int64_t id;
+    int64_t value;
+};
+
+static constexpr size_t kRecords = 100'000;
+
+static int64_t SumRecords(const std::vector<SharedPtr<Record>>& records) {
+    int64_t sum = 0;
+    for (const auto& record : records) {
+        sum += record->value;
+    }
+    return sum;
+}
+
+static void BM_RecordsOneByOne(benchmark::State& state) {
+    for (auto _ : state) {
+        std::vector<SharedPtr<Record>> records;
+        records.reserve(kRecords);
+        for (size_t i = 0; i < kRecords; ++i) {
+            int64_t id = static_cast<int64_t>(i);
+            records.push_back(MakeShared<Record>(Record{id, id * 2}));
+        }
+        benchmark::DoNotOptimize(SumRecords(records));
+    }
+    state.SetItemsProcessed(state.iterations() * kRecords);
+}
+BENCHMARK(BM_RecordsOneByOne)->Unit(benchmark::kMillisecond);
+
+static void BM_RecordsBatch(benchmark::State& state) {
+    for (auto _ : state) {
+        auto records = MakeSharedBatch<Record>(kRecords, [](size_t i) {
+            int64_t id = static_cast<int64_t>(i);
+            return Record{id, id * 2};
+        });
+        benchmark::DoNotOptimize(SumRecords(records));
+    }
+    state.SetItemsProcessed(state.iterations() * kRecords);
+}
+BENCHMARK(BM_RecordsBatch)->Unit(benchmark::kMillisecond);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Published pointer read by every thread; thread 0 also replaces it once in 1024 iterations
+
+namespace {
+
+class MutexSharedPtr {
+public:
+    SharedPtr<int> Load() const {
+        std::lock_guard guard(mutex_);
+        return value_;
+    }
+
+    void Store(SharedPtr<int> desired) {
+        std::lock_guard guard(mutex_);
+        value_ = desired;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    SharedPtr<int> value_;
+};
+
+}  // namespace
+
+template <typename Cell>
+static void BM_PublishedLoad(benchmark::State& state) {
+    static Cell cell;
+    if (state.thread_index() == 0) {
+        cell.Store(MakeShared<int>(0));
+    }
+    int i = 0;
+    for (auto _ : state) {
+        if (state.thread_index() == 0 && ++i == 1024) {
+            i = 0;
+            cell.Store(MakeShared<int>(i));
+        }
+        auto value = cell.Load();
+        benchmark::DoNotOptimize(value);
+    }
+    if (state.thread_index() == 0) {
+        cell.Store(nullptr);
+    }
+}
+BENCHMARK_TEMPLATE(BM_PublishedLoad, MutexSharedPtr)->ThreadRange(1, 8)->UseRealTime();
+BENCHMARK_TEMPLATE(BM_PublishedLoad, AtomicSharedPtr<int>)->ThreadRange(1, 8)->UseRealTime();
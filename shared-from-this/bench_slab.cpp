@@ -0,0 +1,88 @@
+#include "shared.h"
+
+#include <common/slab.h>
+#include <intrusive/intrusive.h>
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Raw allocation throughput, a batch of 256 objects at a time
+
+struct Malloc {
+    static void* Allocate(size_t size) {
+        return std::malloc(size);
+    }
+
+    static void Deallocate(void* ptr, size_t) {
+        std::free(ptr);
+    }
+};
+
+template <typename Allocator>
+static void BM_Allocate(benchmark::State& state) {
+    size_t size = state.range(0);
+    std::vector<void*> objects(256);
+    for (auto _ : state) {
+        for (auto& object : objects) {
+            object = Allocator::Allocate(size);
+        }
+        benchmark::DoNotOptimize(objects.data());
+        for (auto* object : objects) {
+            Allocator::Deallocate(object, size);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * objects.size());
+}
+BENCHMARK_TEMPLATE(BM_Allocate, Malloc)->Arg(32)->Arg(128)->Arg(512);
+BENCHMARK_TEMPLATE(BM_Allocate, SlabAllocator)->Arg(32)->Arg(128)->Arg(512);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// The same factories as in bench_shared_from_this, which use glibc malloc there
+
+static void BM_MakeShared(benchmark::State& state) {
+    for (auto _ : state) {
+        auto sp = MakeSlabShared<int>(42);
+        benchmark::DoNotOptimize(sp);
+    }
+}
+BENCHMARK(BM_MakeShared);
+
+static void BM_FromPointer(benchmark::State& state) {
+    for (auto _ : state) {
+        SlabSharedPtr<int> sp(new int(42));
+        benchmark::DoNotOptimize(sp);
+    }
+}
+BENCHMARK(BM_FromPointer);
+
+namespace {
+
+struct Intrusive : SimpleRefCounted<Intrusive>, SlabAllocated {
+    int value = 42;
+};
+
+}  // namespace
+
+static void BM_MakeIntrusive(benchmark::State& state) {
+    for (auto _ : state) {
+        auto ptr = MakeIntrusive<Intrusive>();
+        benchmark::DoNotOptimize(ptr);
+    }
+}
+BENCHMARK(BM_MakeIntrusive);
+
+// Batches of objects made and dropped by several threads at once
+static void BM_MakeSharedBatch(benchmark::State& state) {
+    std::vector<SlabSharedPtr<int>> batch;
+    for (auto _ : state) {
+        for (int i = 0; i < 256; ++i) {
+            batch.push_back(MakeSlabShared<int>(i));
+        }
+        batch.clear();
+    }
+    state.SetItemsProcessed(state.iterations() * 256);
+}
+BENCHMARK(BM_MakeSharedBatch)->ThreadRange(1, 4)->UseRealTime();
@@ -0,0 +1,255 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <cstdint>
+
+// Biased reference counting (Choi, Shull, Torrellas, PACT 2018)
+//
+// The thread that creates a block owns it and counts its references with plain loads and stores.
+// Every other thread counts in an atomic shared counter, which may go negative when references
+// made by the owner die elsewhere. When the owner lets go of its last reference the two counters
+// are merged and from then on the block behaves like an `AtomicCounter` one.
+//
+// If the shared counter goes negative while the owner still has references, the block is queued
+// to the owner, which merges it in `BiasedCounter::Collect()`, when it lets go of any biased block
+// or when it exits.
+struct BiasedCounter {
+    // Merges blocks queued to the calling thread by other threads
+    static void Collect();
+};
+
+template <typename T>
+using BiasedSharedPtr = SharedPtr<T, BiasedCounter>;
+
+template <typename T>
+using BiasedWeakPtr = WeakPtr<T, BiasedCounter>;
+
+template <>
+struct ControlBlockBase<BiasedCounter>;
+
+// Per-thread record of the blocks queued for merging
+struct BiasedOwner {
+    void Push(ControlBlockBase<BiasedCounter>* block);
+    void Drain();
+    void Exit();
+
+    void AddRef() {
+        refs_.IncRef();
+    }
+
+    void RemRef() {
+        if (refs_.DecRef() == 0) {
+            delete this;
+        }
+    }
+
+private:
+    std::atomic<ControlBlockBase<BiasedCounter>*> queue_ = nullptr;
+    std::atomic<bool> exited_ = false;
+    // The thread itself plus every block biased to it
+    AtomicCounter refs_{1};
+};
+
+inline BiasedOwner* CurrentBiasedOwner() {
+    struct Holder {
+        ~Holder() {
+            owner->Exit();
+        }
+
+        BiasedOwner* owner = new BiasedOwner;
+    };
+    static thread_local Holder holder;
+    return holder.owner;
+}
+
+template <>
+struct ControlBlockBase<BiasedCounter> {
+    enum class Op { kDestroyObject, kFreeBlock, kDestroyAndFree };
+    using Manager = void (*)(ControlBlockBase*, Op);
+
+    explicit ControlBlockBase(Manager manager) : manager_(manager), owner_(CurrentBiasedOwner()) {
+        owner_->AddRef();
+    }
+
+    size_t GetRefCount() const {
+        int64_t count = biased_.load(std::memory_order_relaxed) +
+                        (shared_.load(std::memory_order_relaxed) >> kFlagBits);
+        return count > 0 ? count : 0;
+    }
+
+    size_t GetRefWCount() const {
+        return weak_ref_counter_.RefCount();
+    }
+
+    void AddRef() {
+        if (IsBiased()) {
+            biased_.store(biased_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        } else {
+            shared_.fetch_add(kOne, std::memory_order_relaxed);
+        }
+    }
+
+    // Fails only once the counters are merged and nobody holds the object
+    bool TryAddRef() {
+        if (IsBiased()) {
+            AddRef();
+            return true;
+        }
+        int64_t old = shared_.load(std::memory_order_relaxed);
+        do {
+            if ((old & kMerged) && (old >> kFlagBits) == 0) {
+                return false;
+            }
+        } while (!shared_.compare_exchange_weak(old, old + kOne, std::memory_order_acquire,
+                                                std::memory_order_relaxed));
+        return true;
+    }
+
+    void RemRef() {
+        if (IsBiased()) {
+            size_t count = biased_.load(std::memory_order_relaxed) - 1;
+            biased_.store(count, std::memory_order_relaxed);
+            if (count == 0) {
+                ImplicitMerge();
+            }
+            return;
+        }
+
+        int64_t old = shared_.load(std::memory_order_relaxed);
+        int64_t desired;
+        bool enqueue;
+        do {
+            desired = old - kOne;
+            enqueue = !(old & (kMerged | kQueued)) && (desired >> kFlagBits) < 0;
+            if (enqueue) {
+                desired |= kQueued;
+            }
+        } while (!shared_.compare_exchange_weak(old, desired, std::memory_order_release,
+                                                std::memory_order_relaxed));
+
+        if ((desired & kMerged) && (desired >> kFlagBits) == 0) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            OnLastRef();
+        } else if (enqueue) {
+            // The queue keeps the block itself alive until the owner has merged it
+            AddRefW();
+            owner_->Push(this);
+        }
+    }
+
+    void AddRefW() {
+        weak_ref_counter_.IncRef();
+    }
+
+    void RemRefW() {
+        if (weak_ref_counter_.DecRef() == 0) {
+            manager_(this, Op::kFreeBlock);
+        }
+    }
+
+    void DefDeleter() {
+        manager_(this, Op::kDestroyObject);
+    }
+
+    Manager GetManager() const {
+        return manager_;
+    }
+
+protected:
+    ~ControlBlockBase() {
+        owner_->RemRef();
+    }
+
+private:
+    friend struct BiasedOwner;
+
+    static constexpr int kFlagBits = 2;
+    static constexpr int64_t kQueued = 1;
+    static constexpr int64_t kMerged = 2;
+    static constexpr int64_t kOne = int64_t{1} << kFlagBits;
+
+    bool IsBiased() const {
+        return owner_ == CurrentBiasedOwner() && !merged_;
+    }
+
+    void OnLastRef() {
+        if (weak_ref_counter_.IsUnique()) {
+            manager_(this, Op::kDestroyAndFree);
+        } else {
+            DefDeleter();
+            RemRefW();
+        }
+    }
+
+    // The owner dropped its last reference; only other threads can hold the object now
+    void ImplicitMerge() {
+        auto* owner = owner_;
+        merged_ = true;
+        if ((shared_.fetch_or(kMerged, std::memory_order_acq_rel) >> kFlagBits) == 0) {
+            OnLastRef();
+        }
+        owner->Drain();
+    }
+
+    // Called by the owner, or by anyone once the owner has exited
+    void ExplicitMerge() {
+        if (!merged_) {
+            merged_ = true;
+            int64_t biased = biased_.exchange(0, std::memory_order_relaxed);
+            int64_t old = shared_.fetch_add(biased * kOne + kMerged, std::memory_order_acq_rel);
+            if ((old >> kFlagBits) + biased == 0) {
+                OnLastRef();
+            }
+        }
+        RemRefW();
+    }
+
+    Manager manager_;
+    BiasedOwner* owner_;
+    // Written only by the owner, so no read-modify-write is needed
+    std::atomic<size_t> biased_ = 1;
+    // Other threads' references in the upper bits, `kQueued` and `kMerged` flags in the lower ones
+    std::atomic<int64_t> shared_ = 0;
+    // Read and written only by the owner, or by anyone once the owner has exited
+    bool merged_ = false;
+    ControlBlockBase* next_ = nullptr;
+    AtomicCounter weak_ref_counter_{1};
+};
+
+inline void BiasedOwner::Push(ControlBlockBase<BiasedCounter>* block) {
+    block->next_ = queue_.load(std::memory_order_relaxed);
+    while (!queue_.compare_exchange_weak(block->next_, block, std::memory_order_seq_cst,
+                                         std::memory_order_relaxed)) {
+    }
+    // Either the owner drains after seeing the block or we see that it has gone
+    if (exited_.load(std::memory_order_seq_cst)) {
+        Drain();
+    }
+}
+
+inline void BiasedOwner::Drain() {
+    auto* block = queue_.exchange(nullptr, std::memory_order_seq_cst);
+    while (block != nullptr) {
+        auto* next = block->next_;
+        block->ExplicitMerge();
+        block = next;
+    }
+}
+
+inline void BiasedOwner::Exit() {
+    exited_.store(true, std::memory_order_seq_cst);
+    Drain();
+    RemRef();
+}
+
+inline void BiasedCounter::Collect() {
+    CurrentBiasedOwner()->Drain();
+}
+
+// Allocate memory only once; the calling thread becomes the owner
+template <typename T, typename... Args>
+BiasedSharedPtr<T> MakeBiasedShared(Args&&... args) {
+    return MakeShared<T, BiasedCounter>(std::forward<Args>(args)...);
+}
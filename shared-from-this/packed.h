@@ -0,0 +1,126 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+
+// Strong and weak counts packed into one 64-bit word
+//
+// The strong count lives in the low 32 bits and the weak count in the high ones, so the block
+// carries a single atomic word instead of two and the last strong release learns the weak count
+// from the same `fetch_sub`. If no weak references are left, the block is destroyed and freed
+// without touching the counters again.
+//
+// Either count may hold up to `kMaxCount` references. Going past it calls `std::abort()`: the
+// check leaves 2^31 spare values, so concurrent increments that race with the check still never
+// carry into the other half.
+struct PackedCounter {
+    static constexpr uint32_t kMaxCount = (uint32_t{1} << 31) - 1;
+};
+
+template <typename T>
+using PackedSharedPtr = SharedPtr<T, PackedCounter>;
+
+template <typename T>
+using PackedWeakPtr = WeakPtr<T, PackedCounter>;
+
+template <>
+struct ControlBlockBase<PackedCounter> {
+    enum class Op { kDestroyObject, kFreeBlock, kDestroyAndFree };
+    using Manager = void (*)(ControlBlockBase*, Op);
+
+    explicit ControlBlockBase(Manager manager) : manager_(manager) {
+    }
+
+    size_t GetRefCount() const {
+        return Strong(counts_.load(std::memory_order_relaxed));
+    }
+
+    size_t GetRefWCount() const {
+        return Weak(counts_.load(std::memory_order_relaxed));
+    }
+
+    void AddRef() {
+        CheckOverflow(Strong(counts_.fetch_add(kStrongOne, std::memory_order_relaxed)));
+    }
+
+    bool TryAddRef() {
+        uint64_t counts = counts_.load(std::memory_order_relaxed);
+        do {
+            if (Strong(counts) == 0) {
+                return false;
+            }
+            CheckOverflow(Strong(counts));
+        } while (!counts_.compare_exchange_weak(counts, counts + kStrongOne,
+                                                std::memory_order_acquire,
+                                                std::memory_order_relaxed));
+        return true;
+    }
+
+    void RemRef() {
+        uint64_t counts = counts_.fetch_sub(kStrongOne, std::memory_order_release);
+        if (Strong(counts) != 1) {
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (Weak(counts) == 1) {
+            // Nobody holds the block, and references can only be made from existing ones
+            manager_(this, Op::kDestroyAndFree);
+        } else {
+            DefDeleter();
+            RemRefW();
+        }
+    }
+
+    void AddRefW() {
+        CheckOverflow(Weak(counts_.fetch_add(kWeakOne, std::memory_order_relaxed)));
+    }
+
+    void RemRefW() {
+        if (counts_.fetch_sub(kWeakOne, std::memory_order_release) == kWeakOne) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            manager_(this, Op::kFreeBlock);
+        }
+    }
+
+    void DefDeleter() {
+        manager_(this, Op::kDestroyObject);
+    }
+
+    Manager GetManager() const {
+        return manager_;
+    }
+
+protected:
+    ~ControlBlockBase() = default;
+
+private:
+    static constexpr uint64_t kStrongOne = 1;
+    static constexpr uint64_t kWeakOne = uint64_t{1} << 32;
+
+    static uint32_t Strong(uint64_t counts) {
+        return static_cast<uint32_t>(counts);
+    }
+
+    static uint32_t Weak(uint64_t counts) {
+        return static_cast<uint32_t>(counts >> 32);
+    }
+
+    static void CheckOverflow(uint32_t count) {
+        if (count >= PackedCounter::kMaxCount) {
+            std::abort();
+        }
+    }
+
+    Manager manager_;
+    // One strong and one weak reference, the latter held by the strong owners together
+    std::atomic<uint64_t> counts_ = kStrongOne | kWeakOne;
+};
+
+// Allocate memory only once
+template <typename T, typename... Args>
+PackedSharedPtr<T> MakePackedShared(Args&&... args) {
+    return MakeShared<T, PackedCounter>(std::forward<Args>(args)...);
+}
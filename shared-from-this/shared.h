@@ -2,24 +2,343 @@
 
 #include "sw_fwd.h"
 
+#include <unique/compressed_pair.h>
+
 #include <cstddef>
+#include <span>
 #include "bits/stdc++.h"
 
 class ESFTBase {};
-template <typename T>
+
+// `AllocateShared` block: the object shares one allocation with the counts and a copy of the
+// allocator rebound to the block, which takes no room when it is empty. The object is built and
+// destroyed through the allocator too, so `std::pmr` allocators pass themselves on to it.
+template <typename T, typename Counter, typename Alloc>
+struct ControlBlockAlloc : ControlBlockBase<Counter> {
+    using Op = typename ControlBlockBase<Counter>::Op;
+    using BlockAlloc =
+        typename std::allocator_traits<Alloc>::template rebind_alloc<ControlBlockAlloc>;
+    using ObjectAlloc = typename std::allocator_traits<Alloc>::template rebind_alloc<T>;
+
+    template <typename... Args>
+    static ControlBlockAlloc* Create(const Alloc& alloc, Args&&... args) {
+        BlockAlloc block_alloc(alloc);
+        ControlBlockAlloc* block = std::allocator_traits<BlockAlloc>::allocate(block_alloc, 1);
+        try {
+            new (block) ControlBlockAlloc(block_alloc, std::forward<Args>(args)...);
+        } catch (...) {
+            std::allocator_traits<BlockAlloc>::deallocate(block_alloc, block, 1);
+            throw;
+        }
+        return block;
+    }
+
+    T* GetPtr() {
+        return reinterpret_cast<T*>(&pair_.GetSecond());
+    }
+
+private:
+    template <typename... Args>
+    ControlBlockAlloc(const BlockAlloc& alloc, Args&&... args)
+        : ControlBlockBase<Counter>(&Manage), pair_(alloc) {
+        ObjectAlloc object_alloc(pair_.GetFirst());
+        std::allocator_traits<ObjectAlloc>::construct(object_alloc, GetPtr(),
+                                                      std::forward<Args>(args)...);
+    }
+
+    static void Manage(ControlBlockBase<Counter>* base, Op op) {
+        auto* self = static_cast<ControlBlockAlloc*>(base);
+        if (op != Op::kFreeBlock) {
+            ObjectAlloc object_alloc(self->pair_.GetFirst());
+            std::allocator_traits<ObjectAlloc>::destroy(object_alloc, self->GetPtr());
+        }
+        if (op != Op::kDestroyObject) {
+            BlockAlloc block_alloc(std::move(self->pair_.GetFirst()));
+            self->~ControlBlockAlloc();
+            std::allocator_traits<BlockAlloc>::deallocate(block_alloc, self, 1);
+        }
+    }
+
+    CompressedPair<BlockAlloc, std::aligned_storage_t<sizeof(T), alignof(T)>> pair_;
+};
+
+// Block for pointers released by a custom deleter, which takes no room when it is empty
+template <typename P, typename Counter, typename Deleter>
+struct ControlBlockDeleter : ControlBlockBase<Counter>, BlockAllocation<Counter> {
+    using Op = typename ControlBlockBase<Counter>::Op;
+
+    ControlBlockDeleter(P* ptr, Deleter&& deleter)
+        : ControlBlockBase<Counter>(&Manage), pair_(std::move(deleter), ptr) {
+    }
+
+private:
+    static void Manage(ControlBlockBase<Counter>* base, Op op) {
+        auto* self = static_cast<ControlBlockDeleter*>(base);
+        if (op != Op::kFreeBlock) {
+            self->pair_.GetFirst()(self->pair_.GetSecond());
+        }
+        if (op != Op::kDestroyObject) {
+            delete self;
+        }
+    }
+
+    CompressedPair<Deleter, P*> pair_;
+};
+
+// One of the blocks made together by `MakeSharedBatch`
+//
+// A batch is a single allocation: a header counting the blocks still in use, then the blocks one
+// after another, each with its own counts and object. A block that is no longer referenced gives
+// its slot back to the header, and the last one frees the whole allocation.
+template <typename T, typename Counter>
+struct ControlBlockBatch : ControlBlockBase<Counter> {
+    using Op = typename ControlBlockBase<Counter>::Op;
+
+    // Builds the object of block `i` from `factory(i)` and returns the first block; if the factory
+    // throws, the objects made so far are destroyed and the memory is freed
+    template <typename Factory>
+    static ControlBlockBatch* Create(size_t size, Factory& factory) {
+        constexpr size_t kMaxSize =
+            (std::numeric_limits<size_t>::max() - BlocksOffset()) / sizeof(ControlBlockBatch);
+        if (size > kMaxSize) {
+            throw std::bad_array_new_length();
+        }
+        void* memory = Allocate(BlocksOffset() + size * sizeof(ControlBlockBatch));
+        auto* batch = new (memory) Batch{size};
+        auto* blocks = reinterpret_cast<ControlBlockBatch*>(static_cast<char*>(memory) +
+                                                            BlocksOffset());
+        size_t constructed = 0;
+        try {
+            for (; constructed < size; ++constructed) {
+                new (blocks + constructed) ControlBlockBatch(batch, factory, constructed);
+            }
+        } catch (...) {
+            while (constructed > 0) {
+                auto& block = blocks[--constructed];
+                block.GetPtr()->~T();
+                block.~ControlBlockBatch();
+            }
+            batch->~Batch();
+            Deallocate(memory);
+            throw;
+        }
+        return blocks;
+    }
+
+    T* GetPtr() {
+        return reinterpret_cast<T*>(&storage_);
+    }
+
+private:
+    struct Batch {
+        std::atomic<size_t> blocks;
+    };
+
+    template <typename Factory>
+    ControlBlockBatch(Batch* batch, Factory& factory, size_t index)
+        : ControlBlockBase<Counter>(&Manage), batch_(batch) {
+        new (&storage_) T(factory(index));
+    }
+
+    static constexpr size_t BlocksOffset() {
+        return (sizeof(Batch) + alignof(ControlBlockBatch) - 1) / alignof(ControlBlockBatch) *
+               alignof(ControlBlockBatch);
+    }
+
+    static constexpr bool IsOverAligned() {
+        return alignof(ControlBlockBatch) > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    }
+
+    static void* Allocate(size_t bytes) {
+        if constexpr (IsOverAligned()) {
+            return ::operator new(bytes, std::align_val_t(alignof(ControlBlockBatch)));
+        } else {
+            return ::operator new(bytes);
+        }
+    }
+
+    static void Deallocate(void* memory) {
+        if constexpr (IsOverAligned()) {
+            ::operator delete(memory, std::align_val_t(alignof(ControlBlockBatch)));
+        } else {
+            ::operator delete(memory);
+        }
+    }
+
+    static void Manage(ControlBlockBase<Counter>* base, Op op) {
+        auto* self = static_cast<ControlBlockBatch*>(base);
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            if (op != Op::kFreeBlock) {
+                self->GetPtr()->~T();
+            }
+        }
+        if (op != Op::kDestroyObject) {
+            Batch* batch = self->batch_;
+            self->~ControlBlockBatch();
+            if (batch->blocks.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                batch->~Batch();
+                Deallocate(batch);
+            }
+        }
+    }
+
+    Batch* batch_;
+    std::aligned_storage_t<sizeof(T), alignof(T)> storage_;
+};
+
+// `MakeSharedWithTrailing` block: the header object follows the counts and `size` elements follow
+// the header, all in one allocation
+template <typename Header, typename Elem, typename Counter>
+struct ControlBlockTrailing : ControlBlockBase<Counter> {
+    using Op = typename ControlBlockBase<Counter>::Op;
+
+    static_assert(!std::is_array_v<Header> && !std::is_array_v<Elem>, "Arrays are not supported");
+
+    // Value-initializes the elements, then makes the header from `args`
+    template <typename... Args>
+    static ControlBlockTrailing* Create(size_t size, Args&&... args) {
+        if (size > (std::numeric_limits<size_t>::max() - ElementsOffset()) / sizeof(Elem)) {
+            throw std::bad_array_new_length();
+        }
+        void* memory = Allocate(ElementsOffset() + size * sizeof(Elem));
+        auto* block = new (memory) ControlBlockTrailing(size);
+        size_t constructed = 0;
+        try {
+            for (; constructed < size; ++constructed) {
+                new (block->GetElements() + constructed) Elem();
+            }
+            new (&block->header_) Header(std::forward<Args>(args)...);
+        } catch (...) {
+            block->DestroyElements(constructed);
+            block->~ControlBlockTrailing();
+            Deallocate(memory);
+            throw;
+        }
+        return block;
+    }
+
+    // Null unless `base` is a block of this very type
+    static ControlBlockTrailing* FromBase(ControlBlockBase<Counter>* base) {
+        if (base == nullptr || base->GetManager() != &Manage) {
+            return nullptr;
+        }
+        return static_cast<ControlBlockTrailing*>(base);
+    }
+
+    Header* GetPtr() {
+        return reinterpret_cast<Header*>(&header_);
+    }
+
+    Elem* GetElements() {
+        return reinterpret_cast<Elem*>(reinterpret_cast<char*>(this) + ElementsOffset());
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+private:
+    explicit ControlBlockTrailing(size_t size) : ControlBlockBase<Counter>(&Manage), size_(size) {
+    }
+
+    static constexpr size_t ElementsOffset() {
+        return (sizeof(ControlBlockTrailing) + alignof(Elem) - 1) / alignof(Elem) * alignof(Elem);
+    }
+
+    static constexpr size_t kAlign = std::max(alignof(ControlBlockTrailing), alignof(Elem));
+
+    static void* Allocate(size_t bytes) {
+        if constexpr (kAlign > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return ::operator new(bytes, std::align_val_t(kAlign));
+        } else {
+            return ::operator new(bytes);
+        }
+    }
+
+    static void Deallocate(void* memory) {
+        if constexpr (kAlign > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(memory, std::align_val_t(kAlign));
+        } else {
+            ::operator delete(memory);
+        }
+    }
+
+    void DestroyElements(size_t count) {
+        if constexpr (!std::is_trivially_destructible_v<Elem>) {
+            while (count > 0) {
+                GetElements()[--count].~Elem();
+            }
+        }
+    }
+
+    static void Manage(ControlBlockBase<Counter>* base, Op op) {
+        auto* self = static_cast<ControlBlockTrailing*>(base);
+        if (op != Op::kFreeBlock) {
+            self->GetPtr()->~Header();
+            self->DestroyElements(self->size_);
+        }
+        if (op != Op::kDestroyObject) {
+            self->~ControlBlockTrailing();
+            Deallocate(self);
+        }
+    }
+
+    size_t size_;
+    std::aligned_storage_t<sizeof(Header), alignof(Header)> header_;
+};
+
+template <typename T, typename Counter>
 class SharedPtr {
+    // Pointers from `new[]` must be freed with `delete[]`
+    template <typename P>
+    using Owned = std::conditional_t<std::is_array_v<T>, P[], P>;
+
+    // An array takes only pointers to its own element type, so `Base[]` never owns `Derived`-s
+    template <typename P>
+    using EnableIfOwnable = EnableIfCompatible<
+        Owned<P>, std::conditional_t<std::is_array_v<T>, std::remove_extent_t<T>[], T>>;
+
 public:
+    // `T` itself, or the type of the elements if `T` is an array
+    using ElementType = std::remove_extent_t<T>;
+
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
-    SharedPtr() : data_(nullptr), ptr_(nullptr) {
+    SharedPtr() noexcept : data_(nullptr), ptr_(nullptr) {
     }
 
-    SharedPtr(std::nullptr_t) : data_(nullptr), ptr_(nullptr) {
+    SharedPtr(std::nullptr_t) noexcept : data_(nullptr), ptr_(nullptr) {
     }
 
-    template <typename P>
-    explicit SharedPtr(P* ptr) noexcept : data_(new ControlBlockUs(ptr)), ptr_(ptr) {
+    // If the block cannot be allocated, `ptr` is deleted before the exception leaves
+    template <typename P, typename = EnableIfOwnable<P>>
+    explicit SharedPtr(P* ptr) : data_(nullptr), ptr_(ptr) {
+        try {
+            data_ = new ControlBlockUs<Owned<P>, Counter>(ptr);
+        } catch (...) {
+            if constexpr (std::is_array_v<T>) {
+                delete[] ptr;
+            } else {
+                delete ptr;
+            }
+            throw;
+        }
+        if constexpr (std::is_convertible_v<P*, ESFTBase*>) {
+            ptr_->weak_this = *this;
+        }
+    }
+
+    // If the block cannot be allocated, `deleter` releases `ptr` before the exception leaves
+    template <typename P, typename Deleter,
+              typename = std::enable_if_t<std::is_invocable_v<Deleter&, P*>>>
+    SharedPtr(P* ptr, Deleter deleter) : data_(nullptr), ptr_(ptr) {
+        try {
+            data_ = new ControlBlockDeleter<P, Counter, Deleter>(ptr, std::move(deleter));
+        } catch (...) {
+            deleter(ptr);
+            throw;
+        }
         if constexpr (std::is_convertible_v<P*, ESFTBase*>) {
             ptr_->weak_this = *this;
         }
@@ -28,18 +347,44 @@ public:
     SharedPtr(const SharedPtr& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
         CheckAdd();
     }
-    template <typename P>
-    SharedPtr(SharedPtr<P>& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
+    template <typename P, typename = EnableIfCompatible<P, T>>
+    SharedPtr(SharedPtr<P, Counter>& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
         CheckAdd();
     }
 
-    template <typename P>
-    SharedPtr(SharedPtr<P>&& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
-        CheckAdd();
-        other.Reset();
+    // Moves take the reference over and leave the counts alone
+    template <typename P, typename = EnableIfCompatible<P, T>>
+    SharedPtr(SharedPtr<P, Counter>&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), ptr_(std::exchange(other.ptr_, nullptr)) {
+    }
+
+    template <typename Layout>
+    SharedPtr(ControlBlockMS<T, Counter, Layout>* el) noexcept : data_(el), ptr_(el->GetPtr()) {
+        if constexpr (std::is_convertible_v<T*, ESFTBase*>) {
+            ptr_->weak_this = *this;
+        }
+    }
+
+    SharedPtr(ControlBlockArray<ElementType, Counter>* el) noexcept
+        : data_(el), ptr_(el->GetPtr()) {
+    }
+
+    template <typename Alloc>
+    SharedPtr(ControlBlockAlloc<T, Counter, Alloc>* el) noexcept : data_(el), ptr_(el->GetPtr()) {
+        if constexpr (std::is_convertible_v<T*, ESFTBase*>) {
+            ptr_->weak_this = *this;
+        }
     }
 
-    SharedPtr(ControlBlockMS<T>* el) noexcept : data_(el), ptr_(el->GetPtr()) {
+    SharedPtr(ControlBlockBatch<T, Counter>* el) noexcept : data_(el), ptr_(el->GetPtr()) {
+        if constexpr (std::is_convertible_v<T*, ESFTBase*>) {
+            ptr_->weak_this = *this;
+        }
+    }
+
+    template <typename Elem>
+    SharedPtr(ControlBlockTrailing<T, Elem, Counter>* el) noexcept
+        : data_(el), ptr_(el->GetPtr()) {
         if constexpr (std::is_convertible_v<T*, ESFTBase*>) {
             ptr_->weak_this = *this;
         }
@@ -48,42 +393,32 @@ public:
     // Aliasing constructor
     // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other, T* ptr) noexcept : data_(other.GetBlock()), ptr_(ptr) {
+    SharedPtr(const SharedPtr<Y, Counter>& other, ElementType* ptr) noexcept
+        : data_(other.GetBlock()), ptr_(ptr) {
         CheckAdd();
     }
 
     // Promote `WeakPtr`
     // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
-    explicit SharedPtr(const WeakPtr<T>& other) {
-        if (other.GetBlock()->GetRefCount() == 0) {
+    explicit SharedPtr(const WeakPtr<T, Counter>& other) : SharedPtr(other.TryLock()) {
+        if (data_ == nullptr) {
             throw BadWeakPtr();
         }
-        data_ = other.GetBlock();
-        ptr_ = other.Get();
-        CheckAdd();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
 
     SharedPtr& operator=(const SharedPtr& other) noexcept {
-        if (data_) {
-            data_->DefDeleter();
-        }
+        DelChecking();
         data_ = other.GetBlock();
         ptr_ = other.Get();
         CheckAdd();
         return *this;
     }
-    template <typename P>
-    SharedPtr& operator=(SharedPtr<P>&& other) noexcept {
-        if (data_) {
-            data_->DefDeleter();
-        }
-        data_ = other.GetBlock();
-        ptr_ = other.Get();
-        CheckAdd();
-        other.Reset();
+    template <typename P, typename = EnableIfCompatible<P, T>>
+    SharedPtr& operator=(SharedPtr<P, Counter>&& other) noexcept {
+        SharedPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
@@ -91,56 +426,59 @@ public:
     // Destructor
 
     ~SharedPtr() {
-        if constexpr (std::is_convertible_v<T*, ESFTBase*>) {
-            if (data_->GetRefWCount() <= 1) {
-                ptr_->weak_this.Reset();
-            }
-        }
-        data_->DefDeleter();
+        DelChecking();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
 
-    void Reset() {
-        if (data_) {
-            data_->DefDeleter();
-        }
+    void Reset() noexcept {
+        DelChecking();
         data_ = nullptr;
         ptr_ = nullptr;
     }
-    template <typename P>
+    template <typename P, typename = EnableIfOwnable<P>>
     void Reset(P* ptr) {
-        if (data_) {
-            data_->DefDeleter();
-        }
-        data_ = new ControlBlockUs<P>(ptr);
-        ptr_ = ptr;
+        SharedPtr(ptr).Swap(*this);
+    }
+    template <typename P, typename Deleter>
+    void Reset(P* ptr, Deleter deleter) {
+        SharedPtr(ptr, std::move(deleter)).Swap(*this);
     }
-    void Swap(SharedPtr& other) {
+    void Swap(SharedPtr& other) noexcept {
         std::swap(data_, other.data_);
         std::swap(ptr_, other.ptr_);
     }
     ///////////////////////////////////////////////////////////
     // Observers
 
+    void DelChecking() {
+        if (data_ != nullptr) {
+            data_->RemRef();
+        }
+    }
+
     void CheckAdd() {
         if (data_ != nullptr) {
             data_->AddRef();
         }
     }
-    T* Get() const {
+    ElementType* Get() const {
         return ptr_;
     }
-    ControlBlockBase* GetBlock() const {
+    ControlBlockBase<Counter>* GetBlock() const {
         return data_;
     }
-    T& operator*() const {
+    ElementType& operator*() const {
         return *ptr_;
     }
-    T* operator->() const {
+    ElementType* operator->() const {
         return ptr_;
     }
+    template <typename U = T, typename = std::enable_if_t<std::is_array_v<U>>>
+    ElementType& operator[](ptrdiff_t index) const {
+        return ptr_[index];
+    }
     size_t UseCount() const {
         if (data_ != nullptr) {
             return data_->GetRefCount();
@@ -152,39 +490,184 @@ public:
     }
 
 private:
-    ControlBlockBase* data_ = nullptr;
-    T* ptr_ = nullptr;
+    template <typename U, typename C>
+    friend class SharedPtr;
+    template <typename U, typename C>
+    friend class WeakPtr;
+    template <typename U, typename C>
+    friend class ThinSharedPtr;
+
+    // Takes over a reference the caller has already counted
+    SharedPtr(ControlBlockBase<Counter>* data, ElementType* ptr) noexcept : data_(data), ptr_(ptr) {
+    }
+
+    ControlBlockBase<Counter>* data_ = nullptr;
+    ElementType* ptr_ = nullptr;
 };
 
-template <typename T, typename U>
-inline bool operator==(const SharedPtr<T>& left, const SharedPtr<U>& right) {
+// Owners hold the block and the object but never their own address
+template <typename T, typename Counter>
+struct IsTriviallyRelocatable<SharedPtr<T, Counter>> : std::true_type {};
+
+template <typename T, typename U, typename Counter>
+inline bool operator==(const SharedPtr<T, Counter>& left, const SharedPtr<U, Counter>& right) {
     return left.Get() == right.Get();
 }
 
-// Allocate memory only once
+// Objects at least this big are allocated apart from their counts by `MakeShared`, so that weak
+// references outliving the object keep only the counts alive. Define the macro to tune it, with the
+// same value for the whole program.
+#ifndef SMART_POINTERS_SPLIT_ALLOCATION_THRESHOLD
+#define SMART_POINTERS_SPLIT_ALLOCATION_THRESHOLD (64 * 1024)
+#endif
+
+inline constexpr size_t kSplitAllocationThreshold = SMART_POINTERS_SPLIT_ALLOCATION_THRESHOLD;
+
+// Specialize to decide for a particular type
+template <typename T>
+inline constexpr bool kSplitAllocation = sizeof(T) >= kSplitAllocationThreshold;
+
+// Value-initialized elements
+template <typename T, typename Counter>
+SharedPtr<T, Counter> MakeSharedArray(size_t size) {
+    auto* block = ControlBlockArray<std::remove_extent_t<T>, Counter>::Create(size, nullptr);
+    return SharedPtr<T, Counter>(block);
+}
+
+template <typename T, typename Counter>
+SharedPtr<T, Counter> MakeSharedArray(size_t size, const std::remove_extent_t<T>& init) {
+    auto* block = ControlBlockArray<std::remove_extent_t<T>, Counter>::Create(size, &init);
+    return SharedPtr<T, Counter>(block);
+}
+
+// Allocate memory only once, unless the object is big enough to be split from its counts
+//
+// Arrays always take one allocation: `MakeShared<T[]>(n)`, `MakeShared<T[]>(n, init)`,
+// `MakeShared<T[N]>()` and `MakeShared<T[N]>(init)`.
+template <typename T, typename Counter = AtomicCounter, typename... Args>
+SharedPtr<T, Counter> MakeShared(Args&&... args) {
+    if constexpr (std::is_unbounded_array_v<T>) {
+        return MakeSharedArray<T, Counter>(std::forward<Args>(args)...);
+    } else if constexpr (std::is_bounded_array_v<T>) {
+        return MakeSharedArray<T, Counter>(std::extent_v<T>, std::forward<Args>(args)...);
+    } else if constexpr (kSplitAllocation<T>) {
+        return SharedPtr<T, Counter>(new T(std::forward<Args>(args)...));
+    } else {
+        auto* block = new ControlBlockMS<T, Counter>(std::forward<Args>(args)...);
+        return SharedPtr<T, Counter>(block);
+    }
+}
+
+// Like `MakeShared`, but default-initializes: trivial objects and array elements are left
+// indeterminate, for storage that is about to be overwritten anyway
+template <typename T, typename Counter = AtomicCounter>
+std::enable_if_t<!std::is_unbounded_array_v<T>, SharedPtr<T, Counter>> MakeSharedForOverwrite() {
+    if constexpr (std::is_bounded_array_v<T>) {
+        using Element = std::remove_extent_t<T>;
+        auto* block = ControlBlockArray<Element, Counter>::CreateForOverwrite(std::extent_v<T>);
+        return SharedPtr<T, Counter>(block);
+    } else if constexpr (kSplitAllocation<T>) {
+        return SharedPtr<T, Counter>(new T);
+    } else {
+        auto* block = new ControlBlockMS<T, Counter>(ForOverwrite{});
+        return SharedPtr<T, Counter>(block);
+    }
+}
+
+template <typename T, typename Counter = AtomicCounter>
+std::enable_if_t<std::is_unbounded_array_v<T>, SharedPtr<T, Counter>> MakeSharedForOverwrite(
+    size_t size) {
+    auto* block = ControlBlockArray<std::remove_extent_t<T>, Counter>::CreateForOverwrite(size);
+    return SharedPtr<T, Counter>(block);
+}
+
+// Like `MakeShared`, but the memory comes from `alloc`
+template <typename T, typename Counter = AtomicCounter, typename Alloc, typename... Args>
+SharedPtr<T, Counter> AllocateShared(const Alloc& alloc, Args&&... args) {
+    static_assert(!std::is_array_v<T>, "Arrays are not supported");
+    auto* block = ControlBlockAlloc<T, Counter, Alloc>::Create(alloc, std::forward<Args>(args)...);
+    return SharedPtr<T, Counter>(block);
+}
+
+// Makes `size` objects, the `i`-th from `factory(i)`, with one allocation for all of them
+//
+// The objects and their counts lie next to each other in the order of the result, and the memory
+// is freed once every object and every weak reference to it is gone.
+template <typename T, typename Counter = AtomicCounter, typename Factory>
+std::vector<SharedPtr<T, Counter>> MakeSharedBatch(size_t size, Factory factory) {
+    static_assert(!std::is_array_v<T>, "Arrays are not supported");
+    std::vector<SharedPtr<T, Counter>> result;
+    if (size == 0) {
+        return result;
+    }
+    result.reserve(size);
+    auto* blocks = ControlBlockBatch<T, Counter>::Create(size, factory);
+    for (size_t i = 0; i < size; ++i) {
+        result.emplace_back(blocks + i);
+    }
+    return result;
+}
+
+// Makes a `Header` from `args` followed by `size` value-initialized `Elem`s, all in one allocation
+// with the counts; `GetTrailing` gives the elements back
+template <typename Header, typename Elem, typename Counter = AtomicCounter, typename... Args>
+SharedPtr<Header, Counter> MakeSharedWithTrailing(size_t size, Args&&... args) {
+    auto* block =
+        ControlBlockTrailing<Header, Elem, Counter>::Create(size, std::forward<Args>(args)...);
+    return SharedPtr<Header, Counter>(block);
+}
+
+// The trailing elements of an object made by `MakeSharedWithTrailing<Header, Elem>`; empty for any
+// other owner, including owners sharing the block through the aliasing constructor
+template <typename Elem, typename Header, typename Counter>
+std::span<Elem> GetTrailing(const SharedPtr<Header, Counter>& sp) {
+    using Block =
+        ControlBlockTrailing<std::remove_const_t<Header>, std::remove_const_t<Elem>, Counter>;
+    auto* block = Block::FromBase(sp.GetBlock());
+    if (block == nullptr || sp.Get() != block->GetPtr()) {
+        return {};
+    }
+    return {block->GetElements(), block->Size()};
+}
+
+// Like `MakeShared`, but the object starts on its own cache line, away from the counts
+template <typename T, typename Counter = AtomicCounter, typename... Args>
+SharedPtr<T, Counter> MakeSharedIsolated(Args&&... args) {
+    auto* block = new ControlBlockMS<T, Counter, IsolatedLayout>(std::forward<Args>(args)...);
+    return SharedPtr<T, Counter>(block);
+}
+
 template <typename T, typename... Args>
-SharedPtr<T> MakeShared(Args&&... args) {
-    ControlBlockMS<T>* block = new ControlBlockMS<T>(std::forward<Args>(args)...);
-    return SharedPtr<T>(block);
+LocalSharedPtr<T> MakeLocalShared(Args&&... args) {
+    return MakeShared<T, LocalCounter>(std::forward<Args>(args)...);
+}
+
+template <typename T, typename... Args>
+SlabSharedPtr<T> MakeSlabShared(Args&&... args) {
+    return MakeShared<T, SlabCounter<AtomicCounter>>(std::forward<Args>(args)...);
 }
 
 // Look for usage examples in tests
-template <typename T>
+// The object must be owned by `SharedPtr`s with the same `Counter`
+template <typename T, typename Counter = AtomicCounter>
 class EnableSharedFromThis : public ESFTBase {
 public:
-    SharedPtr<T> SharedFromThis() {
+    SharedPtr<T, Counter> SharedFromThis() {
         return weak_this.Lock();
     }
-    SharedPtr<const T> SharedFromThis() const {
+    SharedPtr<const T, Counter> SharedFromThis() const {
         return weak_this.Lock();
     }
 
-    WeakPtr<T> WeakFromThis() noexcept {
+    WeakPtr<T, Counter> WeakFromThis() noexcept {
         return weak_this;
     }
-    WeakPtr<const T> WeakFromThis() const noexcept {
+    WeakPtr<const T, Counter> WeakFromThis() const noexcept {
         return weak_this;
     }
 
-    WeakPtr<T> weak_this;
+    WeakPtr<T, Counter> weak_this;
 };
+
+template <typename T>
+using EnableLocalSharedFromThis = EnableSharedFromThis<T, LocalCounter>;
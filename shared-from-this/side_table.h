@@ -0,0 +1,184 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+// Weak counts allocated lazily in a side table
+//
+// A block starts with only the strong count, kept inline in one word. The first weak reference
+// (a `WeakPtr` or the `weak_this` of `EnableSharedFromThis`) allocates a side record with both
+// counts and replaces the inline count with a tagged pointer to it; from then on every count goes
+// through the record. Blocks that never see a weak reference pay for one word of counts and no
+// extra allocation.
+//
+// Weak pointers are copied and made from owners in `noexcept` functions, so a side record that
+// cannot be allocated calls `std::abort()` instead of throwing.
+struct SideTableCounter {};
+
+template <typename T>
+using SideTableSharedPtr = SharedPtr<T, SideTableCounter>;
+
+template <typename T>
+using SideTableWeakPtr = WeakPtr<T, SideTableCounter>;
+
+template <>
+struct ControlBlockBase<SideTableCounter> {
+    enum class Op { kDestroyObject, kFreeBlock, kDestroyAndFree };
+    using Manager = void (*)(ControlBlockBase*, Op);
+
+    explicit ControlBlockBase(Manager manager) : manager_(manager) {
+    }
+
+    size_t GetRefCount() const {
+        uintptr_t bits = bits_.load(std::memory_order_acquire);
+        if (bits & kSideTag) {
+            return Side(bits)->strong.load(std::memory_order_relaxed);
+        }
+        return bits >> 1;
+    }
+
+    // Without a side record only the strong owners' own weak reference exists
+    size_t GetRefWCount() const {
+        uintptr_t bits = bits_.load(std::memory_order_acquire);
+        if (bits & kSideTag) {
+            return Side(bits)->weak.load(std::memory_order_relaxed);
+        }
+        return 1;
+    }
+
+    bool HasSideTable() const {
+        return bits_.load(std::memory_order_relaxed) & kSideTag;
+    }
+
+    void AddRef() {
+        uintptr_t bits = bits_.load(std::memory_order_acquire);
+        while (!(bits & kSideTag)) {
+            if (bits_.compare_exchange_weak(bits, bits + kInlineOne, std::memory_order_acquire,
+                                            std::memory_order_acquire)) {
+                return;
+            }
+        }
+        Side(bits)->strong.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Only weak references promote, so the side record already exists
+    bool TryAddRef() {
+        auto& strong = Side(bits_.load(std::memory_order_acquire))->strong;
+        size_t count = strong.load(std::memory_order_relaxed);
+        do {
+            if (count == 0) {
+                return false;
+            }
+        } while (!strong.compare_exchange_weak(count, count + 1, std::memory_order_acquire,
+                                               std::memory_order_relaxed));
+        return true;
+    }
+
+    void RemRef() {
+        uintptr_t bits = bits_.load(std::memory_order_acquire);
+        while (!(bits & kSideTag)) {
+            if (bits_.compare_exchange_weak(bits, bits - kInlineOne, std::memory_order_release,
+                                            std::memory_order_acquire)) {
+                // Weak references would have moved the counts out, so nobody else is left
+                if (bits == kInlineOne) {
+                    std::atomic_thread_fence(std::memory_order_acquire);
+                    manager_(this, Op::kDestroyAndFree);
+                }
+                return;
+            }
+        }
+
+        SideRecord* side = Side(bits);
+        if (side->strong.fetch_sub(1, std::memory_order_release) == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (side->weak.load(std::memory_order_acquire) == 1) {
+                manager_(this, Op::kDestroyAndFree);
+            } else {
+                DefDeleter();
+                RemRefW();
+            }
+        }
+    }
+
+    // The caller holds a strong or a weak reference, so the block cannot die meanwhile
+    void AddRefW() {
+        GetSide()->weak.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void RemRefW() {
+        SideRecord* side = Side(bits_.load(std::memory_order_acquire));
+        if (side->weak.fetch_sub(1, std::memory_order_release) == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            manager_(this, Op::kFreeBlock);
+        }
+    }
+
+    void DefDeleter() {
+        manager_(this, Op::kDestroyObject);
+    }
+
+    Manager GetManager() const {
+        return manager_;
+    }
+
+protected:
+    ~ControlBlockBase() {
+        uintptr_t bits = bits_.load(std::memory_order_relaxed);
+        if (bits & kSideTag) {
+            delete Side(bits);
+        }
+    }
+
+private:
+    struct SideRecord {
+        std::atomic<size_t> strong;
+        // Strong owners hold one weak reference between them
+        std::atomic<size_t> weak = 1;
+    };
+
+    static_assert(alignof(SideRecord) > 1, "The low bit of the pointer is used as a tag");
+
+    static constexpr uintptr_t kSideTag = 1;
+    static constexpr uintptr_t kInlineOne = 2;
+
+    static SideRecord* Side(uintptr_t bits) {
+        return reinterpret_cast<SideRecord*>(bits & ~kSideTag);
+    }
+
+    // Moves the inline strong count into a new side record, unless another thread got there first
+    SideRecord* GetSide() {
+        uintptr_t bits = bits_.load(std::memory_order_acquire);
+        if (bits & kSideTag) {
+            return Side(bits);
+        }
+        auto* side = new (std::nothrow) SideRecord;
+        if (!side) {
+            std::abort();
+        }
+        do {
+            side->strong.store(bits >> 1, std::memory_order_relaxed);
+        } while (!(bits & kSideTag) &&
+                 !bits_.compare_exchange_weak(bits, reinterpret_cast<uintptr_t>(side) | kSideTag,
+                                              std::memory_order_acq_rel,
+                                              std::memory_order_acquire));
+        if (bits & kSideTag) {
+            delete side;
+            return Side(bits);
+        }
+        return side;
+    }
+
+    Manager manager_;
+    // Either the strong count shifted left by one or a pointer to the side record tagged with 1
+    std::atomic<uintptr_t> bits_ = kInlineOne;
+};
+
+// Allocate memory only once, until the first weak reference
+template <typename T, typename... Args>
+SideTableSharedPtr<T> MakeSideTableShared(Args&&... args) {
+    return MakeShared<T, SideTableCounter>(std::forward<Args>(args)...);
+}
@@ -1,96 +1,413 @@
 #pragma once
 
+#include <common/relocation.h>
+#include <common/slab.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
 #include <exception>
+#include <limits>
+#include <new>
+#include <type_traits>
 
 class BadWeakPtr : public std::exception {};
 
-template <typename T>
+// Counter for object graphs that never leave one thread
+class LocalCounter {
+public:
+    explicit LocalCounter(size_t count) : count_(count) {
+    }
+
+    size_t IncRef() {
+        return ++count_;
+    }
+
+    size_t DecRef() {
+        return --count_;
+    }
+
+    bool TryIncRef() {
+        if (count_ == 0) {
+            return false;
+        }
+        ++count_;
+        return true;
+    }
+
+    size_t RefCount() const {
+        return count_;
+    }
+
+    bool IsUnique() const {
+        return count_ == 1;
+    }
+
+private:
+    size_t count_;
+};
+
+// Counter for owners shared between threads
+class AtomicCounter {
+public:
+    explicit AtomicCounter(size_t count) : count_(count) {
+    }
+
+    // A new owner is always created from an existing one, so nothing has to be ordered here
+    size_t IncRef() {
+        return count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    // Every owner publishes its writes with release; the last one acquires them all with a single
+    // fence before the caller destroys anything
+    size_t DecRef() {
+        size_t count = count_.fetch_sub(1, std::memory_order_release) - 1;
+        if (count == 0) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return count;
+    }
+
+    // Increments unless the counter has already dropped to zero
+    bool TryIncRef() {
+        size_t count = count_.load(std::memory_order_relaxed);
+        do {
+            if (count == 0) {
+                return false;
+            }
+        } while (!count_.compare_exchange_weak(count, count + 1, std::memory_order_acquire,
+                                               std::memory_order_relaxed));
+        return true;
+    }
+
+    size_t RefCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    // Acquires the decrements of the other holders, so the caller may free what they used
+    bool IsUnique() const {
+        return count_.load(std::memory_order_acquire) == 1;
+    }
+
+private:
+    std::atomic<size_t> count_;
+};
+
+// Counter that also takes the control blocks of `SharedPtr(P*)` and `MakeShared` from
+// `SlabAllocator`; wraps `LocalCounter` or `AtomicCounter`
+//
+// The allocator is part of the pointer type, so owners that use the slab and owners that do not
+// can live in one program and never free each other's blocks.
+template <typename Counter>
+class SlabCounter : public Counter {
+public:
+    using Counter::Counter;
+};
+
+template <typename Counter>
+inline constexpr bool kUsesSlab = false;
+
+template <typename Counter>
+inline constexpr bool kUsesSlab<SlabCounter<Counter>> = true;
+
+// Base for blocks that keep the global allocator
+struct HeapAllocated {};
+
+template <typename Counter>
+using BlockAllocation = std::conditional_t<kUsesSlab<Counter>, SlabAllocated, HeapAllocated>;
+
+template <typename T, typename Counter = AtomicCounter>
 class SharedPtr;
 
-template <typename T>
+template <typename T, typename Counter = AtomicCounter>
 class WeakPtr;
 
+template <typename T, typename Counter = AtomicCounter>
+class ThinSharedPtr;
+
+// Whether owners of `Y` convert to owners of `T`, as for `std::shared_ptr`: `Y*` must convert to
+// `T*`, which keeps arrays apart from single objects and rejects `Derived[]` to `Base[]`, whose
+// elements have a different stride; `U[N]` also converts to `U[]`
+template <typename Y, typename T>
+inline constexpr bool kIsCompatible = std::is_convertible_v<Y*, T*>;
+
+template <typename U, size_t N, typename T>
+inline constexpr bool kIsCompatible<U[N], T> =
+    std::is_convertible_v<U (*)[N], T*> || std::is_convertible_v<U (*)[], T*>;
+
+template <typename Y, typename T>
+using EnableIfCompatible = std::enable_if_t<kIsCompatible<Y, T>>;
+
+template <typename T>
+using LocalSharedPtr = SharedPtr<T, LocalCounter>;
+
+template <typename T>
+using LocalWeakPtr = WeakPtr<T, LocalCounter>;
+
+template <typename T>
+using SlabSharedPtr = SharedPtr<T, SlabCounter<AtomicCounter>>;
+
+template <typename T>
+using SlabWeakPtr = WeakPtr<T, SlabCounter<AtomicCounter>>;
+
+// Control blocks have no vtable: the concrete block passes one manager function to the base, and
+// the base calls it to destroy the object, to free the block or to do both at once
+template <typename Counter>
 struct ControlBlockBase {
+    enum class Op { kDestroyObject, kFreeBlock, kDestroyAndFree };
+    using Manager = void (*)(ControlBlockBase*, Op);
+
+    explicit ControlBlockBase(Manager manager) : manager_(manager) {
+    }
+
     size_t GetRefCount() const {
-        return ref_counter_;
+        return ref_counter_.RefCount();
     }
 
-    size_t GetRefWCount() {
-        return weak_ref_counter_;
+    // Strong owners hold one weak reference between them, so this is one more than the number of
+    // `WeakPtr`s while the object is alive
+    size_t GetRefWCount() const {
+        return weak_ref_counter_.RefCount();
     }
 
     void AddRef() {
-        ++ref_counter_;
+        ref_counter_.IncRef();
+    }
+
+    // Promotes a weak reference; fails if the object is already destroyed
+    bool TryAddRef() {
+        return ref_counter_.TryIncRef();
     }
 
     void RemRef() {
-        --ref_counter_;
+        if (ref_counter_.DecRef() == 0) {
+            // New weak references are made only from existing ones, so if the owners' reference is
+            // the last one nobody can touch the block any more
+            if (weak_ref_counter_.IsUnique()) {
+                manager_(this, Op::kDestroyAndFree);
+            } else {
+                DefDeleter();
+                RemRefW();
+            }
+        }
     }
 
     void AddRefW() {
-        ++weak_ref_counter_;
+        weak_ref_counter_.IncRef();
     }
 
     void RemRefW() {
-        --weak_ref_counter_;
+        if (weak_ref_counter_.DecRef() == 0) {
+            manager_(this, Op::kFreeBlock);
+        }
     }
 
-    virtual void DefDeleter() {
+    void DefDeleter() {
+        manager_(this, Op::kDestroyObject);
     }
 
-    virtual ~ControlBlockBase() {
+    Manager GetManager() const {
+        return manager_;
     }
 
 protected:
-    size_t ref_counter_ = 1;
-    size_t weak_ref_counter_ = 0;
+    // Blocks are freed only by their manager, which knows the concrete type
+    ~ControlBlockBase() = default;
+
+    Manager manager_;
+    Counter ref_counter_{1};
+    Counter weak_ref_counter_{1};
 };
 
-template <typename T>
-struct ControlBlockUs : ControlBlockBase {
-    ControlBlockUs(T* ptr) {
-        ptr_ = ptr;
-        ref_counter_ = 1;
-    }
+// `T` is an array type for pointers that came from `new[]`
+template <typename T, typename Counter>
+struct ControlBlockUs : ControlBlockBase<Counter>, BlockAllocation<Counter> {
+    using Op = typename ControlBlockBase<Counter>::Op;
 
-    ~ControlBlockUs() override {
+    ControlBlockUs(std::remove_extent_t<T>* ptr) : ControlBlockBase<Counter>(&Manage) {
+        ptr_ = ptr;
     }
 
-    void DefDeleter() override {
-        --ref_counter_;
-        if (!ref_counter_) {
-            delete ptr_;
+private:
+    static void Manage(ControlBlockBase<Counter>* base, Op op) {
+        auto* self = static_cast<ControlBlockUs*>(base);
+        if (op != Op::kFreeBlock) {
+            if constexpr (std::is_array_v<T>) {
+                delete[] self->ptr_;
+            } else {
+                delete self->ptr_;
+            }
         }
-        if (!ref_counter_ && !weak_ref_counter_) {
-            delete this;
+        if (op != Op::kDestroyObject) {
+            delete self;
         }
     }
 
-private:
-    T* ptr_;
+    std::remove_extent_t<T>* ptr_;
 };
 
-template <typename T>
-struct ControlBlockMS : ControlBlockBase {
+inline constexpr size_t kCacheLineSize = 64;
+
+// Where `MakeShared` puts the object relative to the counts
+//
+// `CompactLayout` places it right after them, so a small object shares a cache line with its
+// counts and the whole block is as small as it can be. `IsolatedLayout` starts the object on a
+// cache line of its own, so threads writing to the object do not slow down threads that only copy
+// or drop owners, at the cost of a larger, cache-aligned block.
+struct CompactLayout {};
+struct IsolatedLayout {};
+
+// Asks a block to default-initialize its object, leaving trivial types indeterminate
+struct ForOverwrite {};
+
+template <typename T, typename Counter, typename Layout = CompactLayout>
+struct ControlBlockMS : ControlBlockBase<Counter>, BlockAllocation<Counter> {
+    using Op = typename ControlBlockBase<Counter>::Op;
+
     template <typename... Arg>
-    ControlBlockMS(Arg&&... args) {
+    ControlBlockMS(Arg&&... args) : ControlBlockBase<Counter>(&Manage) {
         new (&storage_) T(std::forward<Arg>(args)...);
     }
+    explicit ControlBlockMS(ForOverwrite) : ControlBlockBase<Counter>(&Manage) {
+        new (&storage_) T;
+    }
     T* GetPtr() {
         return reinterpret_cast<T*>(&storage_);
     }
-    ~ControlBlockMS() override {
+
+    // Null unless `base` is a block of this very type
+    static ControlBlockMS* FromBase(ControlBlockBase<Counter>* base) {
+        if (base == nullptr || base->GetManager() != &Manage) {
+            return nullptr;
+        }
+        return static_cast<ControlBlockMS*>(base);
     }
-    void DefDeleter() override {
-        --ref_counter_;
-        if (!ref_counter_) {
-            GetPtr()->~T();
+
+private:
+    static void Manage(ControlBlockBase<Counter>* base, Op op) {
+        static_assert(alignof(ControlBlockMS) >= kStorageAlign);
+        auto* self = static_cast<ControlBlockMS*>(base);
+        // Trivial objects need no destruction, so both releases only free the block
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            if (op != Op::kFreeBlock) {
+                self->GetPtr()->~T();
+            }
         }
-        if (!ref_counter_ && !weak_ref_counter_) {
-            delete this;
+        if (op != Op::kDestroyObject) {
+            delete self;
         }
     }
 
+    // The block inherits this alignment, so for over-aligned `T` the `new` and `delete` expressions
+    // pick the aligned operators, sized on delete
+    static constexpr size_t kStorageAlign = std::is_same_v<Layout, IsolatedLayout>
+                                                ? std::max(kCacheLineSize, alignof(T))
+                                                : alignof(T);
+
+    std::aligned_storage_t<sizeof(T), kStorageAlign> storage_;
+};
+
+// `MakeShared` block for arrays: the elements follow the counts in the same allocation and are
+// destroyed in reverse order
+template <typename T, typename Counter>
+struct ControlBlockArray : ControlBlockBase<Counter> {
+    using Op = typename ControlBlockBase<Counter>::Op;
+
+    static_assert(!std::is_array_v<T>, "Arrays of arrays are not supported");
+
+    // Copies `*init` into every element, or value-initializes them if `init` is null
+    static ControlBlockArray* Create(size_t size, const T* init) {
+        return Build(size, [init](void* place) {
+            if (init != nullptr) {
+                new (place) T(*init);
+            } else {
+                new (place) T();
+            }
+        });
+    }
+
+    // Default-initializes the elements, which leaves trivial types indeterminate
+    static ControlBlockArray* CreateForOverwrite(size_t size) {
+        return Build(size, [](void* place) { new (place) T; });
+    }
+
+    T* GetPtr() {
+        return reinterpret_cast<T*>(reinterpret_cast<char*>(this) + ElementsOffset());
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
 private:
-    std::aligned_storage_t<sizeof(T), alignof(T)> storage_;
+    explicit ControlBlockArray(size_t size) : ControlBlockBase<Counter>(&Manage), size_(size) {
+    }
+
+    template <typename Construct>
+    static ControlBlockArray* Build(size_t size, Construct construct) {
+        if (size > (std::numeric_limits<size_t>::max() - ElementsOffset()) / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        void* memory = Allocate(ElementsOffset() + size * sizeof(T));
+        auto* block = new (memory) ControlBlockArray(size);
+        size_t constructed = 0;
+        try {
+            for (; constructed < size; ++constructed) {
+                construct(block->GetPtr() + constructed);
+            }
+        } catch (...) {
+            block->DestroyElements(constructed);
+            block->~ControlBlockArray();
+            Deallocate(memory);
+            throw;
+        }
+        return block;
+    }
+
+    static constexpr size_t ElementsOffset() {
+        return (sizeof(ControlBlockArray) + alignof(T) - 1) / alignof(T) * alignof(T);
+    }
+
+    static constexpr size_t kAlign = std::max(alignof(ControlBlockArray), alignof(T));
+
+    static constexpr bool IsOverAligned() {
+        return kAlign > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    }
+
+    static void* Allocate(size_t bytes) {
+        if constexpr (IsOverAligned()) {
+            return ::operator new(bytes, std::align_val_t(kAlign));
+        } else {
+            return ::operator new(bytes);
+        }
+    }
+
+    static void Deallocate(void* memory) {
+        if constexpr (IsOverAligned()) {
+            ::operator delete(memory, std::align_val_t(kAlign));
+        } else {
+            ::operator delete(memory);
+        }
+    }
+
+    void DestroyElements(size_t count) {
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            while (count > 0) {
+                GetPtr()[--count].~T();
+            }
+        }
+    }
+
+    static void Manage(ControlBlockBase<Counter>* base, Op op) {
+        auto* self = static_cast<ControlBlockArray*>(base);
+        if (op != Op::kFreeBlock) {
+            self->DestroyElements(self->size_);
+        }
+        if (op != Op::kDestroyObject) {
+            self->~ControlBlockArray();
+            Deallocate(self);
+        }
+    }
+
+    size_t size_;
 };
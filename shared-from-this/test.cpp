@@ -89,3 +89,127 @@ TEST_CASE("WeakFromThis") {
     REQUIRE(!weak.Expired());
     REQUIRE(weak.Lock().Get() == ptr);
 }
+
+struct LocalNode : EnableLocalSharedFromThis<LocalNode> {};
+
+TEST_CASE("Local counting") {
+    static_assert(!std::is_convertible_v<LocalSharedPtr<int>, SharedPtr<int>>);
+    static_assert(std::is_same_v<decltype(LocalWeakPtr<int>().Lock()), LocalSharedPtr<int>>);
+    static_assert(std::is_same_v<decltype(MakeLocalShared<int>(42)), LocalSharedPtr<int>>);
+
+    auto sp = MakeLocalShared<int>(42);
+    LocalSharedPtr<int> copy = sp;
+    LocalWeakPtr<int> weak = copy;
+    REQUIRE(sp.UseCount() == 2);
+    REQUIRE(*weak.Lock() == 42);
+    sp.Reset();
+    copy.Reset();
+    REQUIRE(weak.Expired());
+
+    LocalNode* ptr = new LocalNode;
+    LocalSharedPtr<LocalNode> node(ptr);
+    REQUIRE(ptr->SharedFromThis() == node);
+    REQUIRE(MakeShared<LocalNode, LocalCounter>()->WeakFromThis().UseCount() == 1);
+}
+
+TEST_CASE("Control block layout") {
+    // The manager pointer is the only word besides the counters and the payload
+    static_assert(!std::is_polymorphic_v<ControlBlockBase<AtomicCounter>>);
+    static_assert(!std::is_polymorphic_v<ControlBlockUs<int, AtomicCounter>>);
+    static_assert(!std::is_polymorphic_v<ControlBlockMS<int, AtomicCounter>>);
+    static_assert(sizeof(ControlBlockBase<AtomicCounter>) ==
+                  sizeof(void*) + 2 * sizeof(AtomicCounter));
+    static_assert(sizeof(ControlBlockBase<LocalCounter>) ==
+                  sizeof(void*) + 2 * sizeof(LocalCounter));
+    static_assert(sizeof(ControlBlockUs<int, AtomicCounter>) ==
+                  sizeof(ControlBlockBase<AtomicCounter>) + sizeof(int*));
+    static_assert(sizeof(ControlBlockMS<int64_t, AtomicCounter>) ==
+                  sizeof(ControlBlockBase<AtomicCounter>) + sizeof(int64_t));
+
+    // The object dies before the block when weak references outlive it
+    auto sp = MakeLocalShared<int>(42);
+    LocalWeakPtr<int> weak = sp;
+    sp.Reset();
+    REQUIRE(weak.Expired());
+    REQUIRE(weak.GetBlock()->GetRefWCount() == 1);
+}
+
+TEST_CASE("Isolated layout") {
+    static_assert(sizeof(ControlBlockMS<int, AtomicCounter>) <= kCacheLineSize / 2);
+    static_assert(sizeof(ControlBlockMS<int, AtomicCounter, IsolatedLayout>) ==
+                  2 * kCacheLineSize);
+    static_assert(alignof(ControlBlockMS<int, AtomicCounter, IsolatedLayout>) == kCacheLineSize);
+
+    auto offset = [](const auto& sp) {
+        return reinterpret_cast<const char*>(sp.Get()) -
+               reinterpret_cast<const char*>(sp.GetBlock());
+    };
+    auto compact = MakeShared<int>(1);
+    auto isolated = MakeSharedIsolated<int>(2);
+    REQUIRE(offset(compact) < static_cast<ptrdiff_t>(kCacheLineSize));
+    REQUIRE(offset(isolated) == static_cast<ptrdiff_t>(kCacheLineSize));
+    REQUIRE(reinterpret_cast<uintptr_t>(isolated.Get()) % kCacheLineSize == 0);
+    REQUIRE(*isolated == 2);
+
+    auto node = MakeSharedIsolated<LocalNode, LocalCounter>();
+    REQUIRE(node->SharedFromThis() == node);
+    REQUIRE(node.UseCount() == 1);
+}
+
+// Local counts that remember how often they were touched
+class CountingCounter : public LocalCounter {
+public:
+    explicit CountingCounter(size_t count) : LocalCounter(count) {
+    }
+
+    size_t IncRef() {
+        ++increments;
+        return LocalCounter::IncRef();
+    }
+
+    size_t DecRef() {
+        ++decrements;
+        return LocalCounter::DecRef();
+    }
+
+    inline static int increments = 0;
+    inline static int decrements = 0;
+};
+
+struct CountedBase {
+    virtual ~CountedBase() = default;
+};
+
+struct Counted : CountedBase {};
+
+TEST_CASE("Moves leave the counts alone") {
+    auto sp = MakeShared<Counted, CountingCounter>();
+    auto other = MakeShared<Counted, CountingCounter>();
+    WeakPtr<Counted, CountingCounter> weak = sp;
+    CountingCounter::increments = 0;
+    CountingCounter::decrements = 0;
+
+    SharedPtr<Counted, CountingCounter> moved = std::move(sp);
+    SharedPtr<CountedBase, CountingCounter> base = std::move(moved);
+    SharedPtr<CountedBase, CountingCounter> owner;
+    owner = std::move(base);
+    owner = std::move(owner);  // NOLINT
+    SharedPtr<CountedBase, CountingCounter> assigned;
+    assigned = std::move(other);
+
+    WeakPtr<Counted, CountingCounter> weak_moved = std::move(weak);
+    WeakPtr<CountedBase, CountingCounter> weak_base = std::move(weak_moved);
+    WeakPtr<CountedBase, CountingCounter> weak_assigned;
+    weak_assigned = std::move(weak_base);
+
+    REQUIRE(CountingCounter::increments == 0);
+    REQUIRE(CountingCounter::decrements == 0);
+    REQUIRE(owner.UseCount() == 1);
+    REQUIRE(assigned.UseCount() == 1);
+    REQUIRE(weak_assigned.Lock() == owner);
+    REQUIRE(!sp);
+    REQUIRE(!moved);
+    REQUIRE(!base);
+    REQUIRE(weak.Expired());
+    REQUIRE(weak_base.Expired());
+}
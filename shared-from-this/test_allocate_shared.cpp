@@ -0,0 +1,103 @@
+#include "shared.h"
+#include "weak.h"
+
+#include <catch.hpp>
+
+#include <memory_resource>
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+int allocations = 0;
+int deallocations = 0;
+
+template <typename T>
+struct CountingAllocator {
+    using value_type = T;
+
+    CountingAllocator() = default;
+
+    template <typename U>
+    CountingAllocator(const CountingAllocator<U>&) noexcept {
+    }
+
+    T* allocate(size_t n) {
+        ++allocations;
+        return std::allocator<T>().allocate(n);
+    }
+
+    void deallocate(T* ptr, size_t n) noexcept {
+        ++deallocations;
+        std::allocator<T>().deallocate(ptr, n);
+    }
+
+    template <typename U>
+    bool operator==(const CountingAllocator<U>&) const {
+        return true;
+    }
+};
+
+struct Node : EnableSharedFromThis<Node> {
+    explicit Node(int value) : value(value) {
+    }
+
+    int value;
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("AllocateShared layout") {
+    // Empty allocators take no room
+    static_assert(sizeof(ControlBlockAlloc<int, AtomicCounter, CountingAllocator<int>>) ==
+                  sizeof(ControlBlockMS<int, AtomicCounter>));
+    static_assert(sizeof(ControlBlockAlloc<int, AtomicCounter, std::allocator<int>>) ==
+                  sizeof(ControlBlockMS<int, AtomicCounter>));
+    using PmrAllocator = std::pmr::polymorphic_allocator<int>;
+    static_assert(sizeof(ControlBlockAlloc<int, AtomicCounter, PmrAllocator>) ==
+                  sizeof(ControlBlockMS<int, AtomicCounter>) + sizeof(void*));
+}
+
+TEST_CASE("AllocateShared with a custom allocator") {
+    allocations = 0;
+    deallocations = 0;
+    {
+        auto sp = AllocateShared<std::string>(CountingAllocator<char>(), 3, 'x');
+        REQUIRE(*sp == "xxx");
+        REQUIRE(allocations == 1);
+
+        // The block stays until the last weak reference is gone
+        WeakPtr<std::string> weak = sp;
+        sp.Reset();
+        REQUIRE(weak.Expired());
+        REQUIRE(deallocations == 0);
+    }
+    REQUIRE(deallocations == 1);
+
+    auto node = AllocateShared<Node>(CountingAllocator<Node>(), 42);
+    REQUIRE(node->value == 42);
+    REQUIRE(node->SharedFromThis().Get() == node.Get());
+}
+
+TEST_CASE("AllocateShared with a memory resource") {
+    alignas(std::max_align_t) char buffer[1024];
+    std::pmr::monotonic_buffer_resource resource(buffer, sizeof(buffer),
+                                                 std::pmr::null_memory_resource());
+    std::pmr::polymorphic_allocator<std::pmr::string> alloc(&resource);
+
+    auto sp = AllocateShared<std::pmr::string>(alloc, "a string too long for the small buffer");
+    auto inside = [&](const void* ptr) {
+        return static_cast<const char*>(ptr) >= buffer &&
+               static_cast<const char*>(ptr) < buffer + sizeof(buffer);
+    };
+    REQUIRE(inside(sp.GetBlock()));
+    // The string got the resource through uses-allocator construction
+    REQUIRE(sp->get_allocator().resource() == &resource);
+    REQUIRE(inside(sp->data()));
+
+    SharedPtr<std::pmr::string> copy = sp;
+    REQUIRE(copy.UseCount() == 2);
+}
@@ -0,0 +1,114 @@
+#include "atomic_shared.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Config {
+    explicit Config(int version) : version(version), check(-version) {
+        alive.fetch_add(1);
+    }
+
+    ~Config() {
+        alive.fetch_sub(1);
+    }
+
+    int version;
+    int check;
+
+    inline static std::atomic<int> alive = 0;
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("AtomicSharedPtr basics") {
+    static_assert(AtomicSharedPtr<int>::IsLockFree());
+    {
+        AtomicSharedPtr<Config> cell;
+        REQUIRE(cell.Load().Get() == nullptr);
+
+        auto first = MakeShared<Config>(1);
+        cell.Store(first);
+        REQUIRE(cell.Load() == first);
+        REQUIRE(first.UseCount() == 2);
+
+        auto old = cell.Exchange(MakeShared<Config>(2));
+        REQUIRE(old == first);
+        REQUIRE(first.UseCount() == 2);
+        old.Reset();
+        REQUIRE(first.UseCount() == 1);
+        REQUIRE(cell.Load()->version == 2);
+
+        SharedPtr<Config> expected = first;
+        REQUIRE(!cell.CompareExchange(expected, MakeShared<Config>(3)));
+        REQUIRE(expected->version == 2);
+        REQUIRE(cell.CompareExchange(expected, first));
+        REQUIRE(cell.Load() == first);
+        expected.Reset();
+
+        // Same object, but not the same owner
+        SharedPtr<Config> alias(MakeShared<Config>(4), first.Get());
+        REQUIRE(!cell.CompareExchange(alias, nullptr));
+        REQUIRE(alias.GetBlock() == first.GetBlock());
+        alias.Reset();
+
+        cell.Store(nullptr);
+        REQUIRE(cell.Load().Get() == nullptr);
+        REQUIRE(first.UseCount() == 1);
+
+        SharedPtr<Config> empty;
+        REQUIRE(cell.CompareExchange(empty, first));
+        REQUIRE(Config::alive == 1);
+    }
+    REQUIRE(Config::alive == 0);
+}
+
+TEST_CASE("AtomicSharedPtr readers and writers") {
+    constexpr int kReaders = 6;
+    constexpr int kWriters = 2;
+    constexpr int kVersions = 20'000;
+
+    std::atomic<int> bad_reads = 0;
+    std::atomic<int> writers_done = 0;
+    {
+        AtomicSharedPtr<Config> cell(MakeShared<Config>(0));
+        std::vector<std::thread> threads;
+        for (int i = 0; i < kReaders; ++i) {
+            threads.emplace_back([&] {
+                while (writers_done != kWriters) {
+                    auto config = cell.Load();
+                    if (config->check != -config->version) {
+                        ++bad_reads;
+                    }
+                }
+            });
+        }
+        for (int i = 0; i < kWriters; ++i) {
+            threads.emplace_back([&, i] {
+                for (int version = 1; version <= kVersions; ++version) {
+                    if (i == 0) {
+                        cell.Store(MakeShared<Config>(version));
+                    } else {
+                        auto expected = cell.Load();
+                        cell.CompareExchange(expected, MakeShared<Config>(version));
+                    }
+                }
+                ++writers_done;
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(cell.Load().UseCount() == 2);
+    }
+    REQUIRE(bad_reads == 0);
+    REQUIRE(Config::alive == 0);
+}
@@ -0,0 +1,126 @@
+#include "biased.h"
+#include "tracked.h"
+#include "weak.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+using Node = TrackedNode<BiasedCounter>;
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Biased owner thread") {
+    {
+        auto sp = MakeBiasedShared<Tracked>();
+        BiasedSharedPtr<Tracked> copy = sp;
+        BiasedWeakPtr<Tracked> weak = copy;
+        REQUIRE(sp.UseCount() == 2);
+        REQUIRE(weak.Lock()->value == 42);
+        copy.Reset();
+        REQUIRE(sp.UseCount() == 1);
+        sp.Reset();
+        REQUIRE(weak.Expired());
+        REQUIRE(weak.TryLock().Get() == nullptr);
+        REQUIRE(Tracked::alive == 0);
+    }
+
+    Node* ptr = new Node;
+    BiasedSharedPtr<Node> node(ptr);
+    REQUIRE(ptr->SharedFromThis() == node);
+    REQUIRE(node.UseCount() == 1);
+}
+
+TEST_CASE("Biased copies dropped by other threads") {
+    auto sp = MakeBiasedShared<Tracked>();
+    std::vector<BiasedSharedPtr<Tracked>> copies(8, sp);
+    std::vector<std::thread> threads;
+    for (auto& copy : copies) {
+        threads.emplace_back([owner = std::move(copy)]() mutable {
+            BiasedSharedPtr<Tracked> local = owner;
+            owner.Reset();
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    // Every copy died elsewhere, so the shared counter went negative and the block was queued
+    REQUIRE(sp.UseCount() == 1);
+    BiasedCounter::Collect();
+    REQUIRE(sp.UseCount() == 1);
+    REQUIRE(Tracked::alive == 1);
+    sp.Reset();
+    REQUIRE(Tracked::alive == 0);
+}
+
+TEST_CASE("Owner lets go first") {
+    auto sp = MakeBiasedShared<Tracked>();
+    std::atomic<bool> copied = false;
+    std::atomic<bool> released = false;
+    std::atomic<int> alive_after_release = 0;
+    std::thread thread([&] {
+        BiasedSharedPtr<Tracked> local = sp;
+        copied = true;
+        while (!released) {
+            std::this_thread::yield();
+        }
+        alive_after_release = Tracked::alive.load();
+        local.Reset();
+    });
+    while (!copied) {
+        std::this_thread::yield();
+    }
+    sp.Reset();
+    released = true;
+    thread.join();
+    REQUIRE(alive_after_release == 1);
+    REQUIRE(Tracked::alive == 0);
+}
+
+TEST_CASE("Biased TryLock from another thread") {
+    auto sp = MakeBiasedShared<Tracked>();
+    BiasedWeakPtr<Tracked> weak(sp);
+    bool locked = false;
+    std::thread([&] { locked = static_cast<bool>(weak.TryLock()); }).join();
+    REQUIRE(locked);
+
+    sp.Reset();
+    std::thread([&] { locked = static_cast<bool>(weak.TryLock()); }).join();
+    REQUIRE(!locked);
+}
+
+TEST_CASE("Queued block is merged by the owner") {
+    auto sp = MakeBiasedShared<Tracked>();
+    BiasedSharedPtr<Tracked> copy = sp;
+    std::thread([other = std::move(copy)]() mutable { other.Reset(); }).join();
+
+    // The biased count still includes the reference dropped by the other thread
+    sp.Reset();
+    REQUIRE(Tracked::alive == 1);
+    BiasedCounter::Collect();
+    REQUIRE(Tracked::alive == 0);
+}
+
+TEST_CASE("Owner thread exits") {
+    BiasedSharedPtr<Tracked> sp;
+    std::thread([&sp] {
+        auto local = MakeBiasedShared<Tracked>();
+        sp = local;
+    }).join();
+
+    REQUIRE(Tracked::alive == 1);
+    BiasedSharedPtr<Tracked> copy = sp;
+    sp.Reset();
+    REQUIRE(Tracked::alive == 1);
+    copy.Reset();
+    REQUIRE(Tracked::alive == 0);
+}
@@ -0,0 +1,73 @@
+#include "packed.h"
+#include "tracked.h"
+#include "weak.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+using Node = TrackedNode<PackedCounter>;
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Packed layout") {
+    static_assert(sizeof(ControlBlockBase<PackedCounter>) == 2 * sizeof(void*));
+    static_assert(sizeof(ControlBlockBase<PackedCounter>) <
+                  sizeof(ControlBlockBase<AtomicCounter>));
+    static_assert(sizeof(ControlBlockMS<int64_t, PackedCounter>) == 3 * sizeof(void*));
+    static_assert(PackedCounter::kMaxCount == 0x7fff'ffff);
+}
+
+TEST_CASE("Packed counts") {
+    {
+        auto sp = MakePackedShared<Tracked>();
+        PackedSharedPtr<Tracked> copy = sp;
+        PackedWeakPtr<Tracked> weak = copy;
+        REQUIRE(sp.UseCount() == 2);
+        REQUIRE(sp.GetBlock()->GetRefWCount() == 2);
+        REQUIRE(weak.Lock()->value == 42);
+        copy.Reset();
+        sp.Reset();
+        REQUIRE(Tracked::alive == 0);
+        REQUIRE(weak.Expired());
+        REQUIRE(weak.TryLock().Get() == nullptr);
+        REQUIRE_THROWS_AS(PackedSharedPtr<Tracked>(weak), BadWeakPtr);
+    }
+
+    Node* ptr = new Node;
+    PackedSharedPtr<Node> node(ptr);
+    REQUIRE(ptr->SharedFromThis() == node);
+    REQUIRE(node.UseCount() == 1);
+}
+
+TEST_CASE("Packed counts from several threads") {
+    constexpr int kThreads = 8;
+    constexpr int kIterations = 10'000;
+
+    auto sp = MakePackedShared<Tracked>();
+    PackedWeakPtr<Tracked> weak = sp;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([owner = sp, weak] {
+            for (int j = 0; j < kIterations; ++j) {
+                PackedSharedPtr<Tracked> copy = owner;
+                PackedWeakPtr<Tracked> weak_copy = weak;
+                weak_copy.TryLock();
+            }
+        });
+    }
+    sp.Reset();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(Tracked::alive == 0);
+    REQUIRE(weak.GetBlock()->GetRefWCount() == 1);
+}
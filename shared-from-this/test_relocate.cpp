@@ -0,0 +1,128 @@
+#include "shared.h"
+#include "thin.h"
+#include "weak.h"
+
+#include <intrusive/intrusive.h>
+
+#include <catch.hpp>
+
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Node : SimpleRefCounted<Node> {};
+
+// Copies throw once `copies_left` runs out; there is no move constructor
+struct Fragile {
+    explicit Fragile(int value) : value(value) {
+    }
+
+    Fragile(const Fragile& other) : value(other.value) {
+        if (copies_left-- == 0) {
+            throw 42;
+        }
+    }
+
+    int value;
+
+    inline static int copies_left = 1'000'000;
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Pointers are trivially relocatable") {
+    static_assert(kIsTriviallyRelocatable<SharedPtr<int>>);
+    static_assert(kIsTriviallyRelocatable<SharedPtr<int[], LocalCounter>>);
+    static_assert(kIsTriviallyRelocatable<WeakPtr<int>>);
+    static_assert(kIsTriviallyRelocatable<ThinSharedPtr<int, AtomicCounter>>);
+    static_assert(kIsTriviallyRelocatable<IntrusivePtr<Node>>);
+    static_assert(!kIsTriviallyRelocatable<std::string>);
+
+    static_assert(std::is_nothrow_move_constructible_v<SharedPtr<int>>);
+    static_assert(std::is_nothrow_move_assignable_v<SharedPtr<int>>);
+    static_assert(std::is_nothrow_move_constructible_v<WeakPtr<int>>);
+    static_assert(std::is_nothrow_move_assignable_v<WeakPtr<int>>);
+    static_assert(std::is_nothrow_move_constructible_v<IntrusivePtr<Node>>);
+    static_assert(std::is_nothrow_move_assignable_v<IntrusivePtr<Node>>);
+}
+
+TEST_CASE("RelocatingVector") {
+    SECTION("Owners survive growth") {
+        auto sp = MakeShared<int>(42);
+        WeakPtr<int> weak = sp;
+        RelocatingVector<SharedPtr<int>> owners;
+        RelocatingVector<WeakPtr<int>> weaks;
+        for (int i = 0; i < 1000; ++i) {
+            owners.PushBack(sp);
+            weaks.PushBack(weak);
+        }
+        REQUIRE(owners.Size() == 1000);
+        REQUIRE(owners.Capacity() >= 1000);
+        REQUIRE(sp.UseCount() == 1001);
+        REQUIRE(sp.GetBlock()->GetRefWCount() == 1002);
+        for (const auto& owner : owners) {
+            REQUIRE(owner == sp);
+        }
+
+        owners.PopBack();
+        REQUIRE(sp.UseCount() == 1000);
+        owners.Clear();
+        weaks.Clear();
+        REQUIRE(sp.UseCount() == 1);
+        REQUIRE(sp.GetBlock()->GetRefWCount() == 2);
+    }
+
+    SECTION("Element of the vector itself") {
+        RelocatingVector<std::string> strings;
+        strings.PushBack("a long string that does not fit into the small buffer");
+        for (int i = 0; i < 10; ++i) {
+            strings.PushBack(strings[0]);
+        }
+        for (const auto& string : strings) {
+            REQUIRE(string == strings[0]);
+        }
+
+        RelocatingVector<IntrusivePtr<Node>> nodes;
+        nodes.EmplaceBack(new Node);
+        for (int i = 0; i < 10; ++i) {
+            nodes.PushBack(nodes[0]);
+        }
+        REQUIRE(nodes[0].UseCount() == 11);
+    }
+
+    SECTION("Reserve and move") {
+        RelocatingVector<SharedPtr<int>> owners;
+        owners.Reserve(10);
+        REQUIRE(owners.Capacity() == 10);
+        owners.PushBack(MakeShared<int>(1));
+        auto other = std::move(owners);
+        REQUIRE(owners.Empty());
+        REQUIRE(*other[0] == 1);
+        owners = std::move(other);
+        REQUIRE(other.Empty());
+        REQUIRE(other.Capacity() == 0);
+        REQUIRE(*owners[0] == 1);
+    }
+
+    SECTION("Copies that throw while growing") {
+        RelocatingVector<Fragile> values;
+        values.Reserve(4);
+        for (int i = 0; i < 4; ++i) {
+            values.EmplaceBack(i);
+        }
+        Fragile::copies_left = 2;
+        REQUIRE_THROWS_AS(values.EmplaceBack(4), int);
+        Fragile::copies_left = 1'000'000;
+
+        // The old buffer is left as it was
+        REQUIRE(values.Size() == 4);
+        REQUIRE(values.Capacity() == 4);
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(values[i].value == i);
+        }
+    }
+}
@@ -5,6 +5,8 @@
 #include "allocations_checker.h"
 
 #include <memory>
+#include <string>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -467,3 +469,399 @@ TEST_CASE("Destructor for correct type") {
         REQUIRE(B::destructor_called);
     }
 }
+
+struct Ordered {
+    Ordered() : id(next_id++) {
+        if (id == throw_at) {
+            throw 42;
+        }
+    }
+
+    Ordered(const Ordered&) : Ordered() {
+    }
+
+    ~Ordered() {
+        destroyed.push_back(id);
+    }
+
+    int id;
+
+    static inline int next_id = 0;
+    static inline int throw_at = -1;
+    static inline std::vector<int> destroyed;
+};
+
+struct alignas(64) Wide {
+    char data[64];
+};
+
+template <typename P>
+constexpr bool kCanIndex = requires(P p) { p[0]; };
+
+template <typename P, typename U>
+constexpr bool kCanReset = requires(P p, U* ptr) { p.Reset(ptr); };
+
+TEST_CASE("Arrays") {
+    SECTION("Unbounded") {
+        SharedPtr<int[]> sp;
+        EXPECT_ONE_ALLOCATION(sp = MakeShared<int[]>(5));
+        for (int i = 0; i < 5; ++i) {
+            REQUIRE(sp[i] == 0);
+            sp[i] = i;
+        }
+        SharedPtr<int[]> copy = sp;
+        REQUIRE(copy[4] == 4);
+        REQUIRE(sp.UseCount() == 2);
+
+        auto strings = MakeShared<std::string[]>(3, "abc");
+        REQUIRE(strings[0] == "abc");
+        REQUIRE(strings[2] == "abc");
+        REQUIRE(MakeShared<int[]>(0).UseCount() == 1);
+    }
+
+    SECTION("Bounded") {
+        auto sp = MakeShared<int[4]>();
+        REQUIRE(sp[3] == 0);
+        auto filled = MakeShared<int[4], LocalCounter>(7);
+        REQUIRE(filled[0] == 7);
+        REQUIRE(filled[3] == 7);
+        SharedPtr<int[]> unbounded = sp;
+        REQUIRE(unbounded.Get() == sp.Get());
+    }
+
+    SECTION("Reverse destruction") {
+        Ordered::next_id = 0;
+        Ordered::destroyed.clear();
+        MakeShared<Ordered[]>(4);
+        REQUIRE(Ordered::destroyed == std::vector<int>{3, 2, 1, 0});
+    }
+
+    SECTION("Faulty element constructor") {
+        Ordered::next_id = 0;
+        Ordered::throw_at = 2;
+        Ordered::destroyed.clear();
+        REQUIRE_THROWS_AS(MakeShared<Ordered[]>(4), int);
+        REQUIRE(Ordered::destroyed == std::vector<int>{1, 0});
+        Ordered::throw_at = -1;
+    }
+
+    SECTION("From new[]") {
+        Ordered::destroyed.clear();
+        SharedPtr<Ordered[]> sp(new Ordered[3]);
+        sp.Reset(new Ordered[2]);
+        REQUIRE(Ordered::destroyed.size() == 3);
+    }
+
+    SECTION("Conversions") {
+        static_assert(std::is_convertible_v<SharedPtr<int[4]>, SharedPtr<int[]>>);
+        static_assert(std::is_convertible_v<SharedPtr<int[]>, SharedPtr<const int[]>>);
+        static_assert(!std::is_convertible_v<SharedPtr<Derived[]>, SharedPtr<Base[]>>);
+        static_assert(!std::is_convertible_v<SharedPtr<Derived[]>&, SharedPtr<Base[]>>);
+        static_assert(!std::is_assignable_v<SharedPtr<Base[]>&, SharedPtr<Derived[]>>);
+        static_assert(!std::is_convertible_v<SharedPtr<Derived[]>, SharedPtr<Base>>);
+        static_assert(!std::is_convertible_v<SharedPtr<int[]>, SharedPtr<int>>);
+        static_assert(!std::is_convertible_v<SharedPtr<int>, SharedPtr<int[]>>);
+        static_assert(std::is_constructible_v<SharedPtr<const int[]>, int*>);
+        static_assert(std::is_constructible_v<SharedPtr<Base>, Derived*>);
+        static_assert(!std::is_constructible_v<SharedPtr<Base[]>, Derived*>);
+        static_assert(!std::is_constructible_v<SharedPtr<Derived>, Base*>);
+        static_assert(kCanReset<SharedPtr<Base>, Derived>);
+        static_assert(!kCanReset<SharedPtr<Base[]>, Derived>);
+        static_assert(kCanIndex<SharedPtr<int[]>>);
+        static_assert(!kCanIndex<SharedPtr<int>>);
+    }
+
+    SECTION("Over-aligned elements") {
+        auto sp = MakeShared<Wide[]>(3);
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(reinterpret_cast<uintptr_t>(&sp[i]) % alignof(Wide) == 0);
+        }
+    }
+}
+
+struct DefaultCounted {
+    DefaultCounted() {
+        ++constructed;
+    }
+
+    int value = 7;
+
+    static inline int constructed = 0;
+};
+
+TEST_CASE("MakeSharedForOverwrite") {
+    SECTION("Single object") {
+        SharedPtr<int> sp;
+        EXPECT_ONE_ALLOCATION(sp = MakeSharedForOverwrite<int>());
+        *sp = 42;
+        REQUIRE(*sp == 42);
+        REQUIRE(MakeSharedForOverwrite<DefaultCounted>()->value == 7);
+    }
+
+    SECTION("Arrays") {
+        SharedPtr<int[]> buffer;
+        EXPECT_ONE_ALLOCATION(buffer = MakeSharedForOverwrite<int[]>(1000));
+        for (int i = 0; i < 1000; ++i) {
+            buffer[i] = i;
+        }
+        REQUIRE(buffer[999] == 999);
+
+        DefaultCounted::constructed = 0;
+        auto bounded = MakeSharedForOverwrite<DefaultCounted[4], LocalCounter>();
+        REQUIRE(DefaultCounted::constructed == 4);
+        REQUIRE(bounded[3].value == 7);
+    }
+}
+
+struct CountingDeleter {
+    void operator()(int* ptr) const {
+        ++calls;
+        delete ptr;
+    }
+
+    static inline int calls = 0;
+};
+
+struct PoolDeleter {
+    void operator()(int* ptr) const {
+        pool->push_back(ptr);
+    }
+
+    std::vector<int*>* pool;
+};
+
+void FreeInt(int* ptr) {
+    delete ptr;
+}
+
+TEST_CASE("Custom deleters") {
+    SECTION("Stateless deleters take no room") {
+        auto lambda = [](int* ptr) { delete ptr; };
+        static_assert(sizeof(ControlBlockDeleter<int, AtomicCounter, CountingDeleter>) ==
+                      sizeof(ControlBlockUs<int, AtomicCounter>));
+        static_assert(sizeof(ControlBlockDeleter<int, AtomicCounter, decltype(lambda)>) ==
+                      sizeof(ControlBlockUs<int, AtomicCounter>));
+        static_assert(sizeof(ControlBlockDeleter<int, AtomicCounter, void (*)(int*)>) ==
+                      sizeof(ControlBlockUs<int, AtomicCounter>) + sizeof(void*));
+        static_assert(sizeof(SharedPtr<int>) == 2 * sizeof(void*));
+    }
+
+    SECTION("Called once by the last owner") {
+        CountingDeleter::calls = 0;
+        {
+            int* ptr = new int(42);
+            SharedPtr<int> sp;
+            EXPECT_ONE_ALLOCATION(sp = SharedPtr<int>(ptr, CountingDeleter()));
+            SharedPtr<int> copy = sp;
+            sp.Reset();
+            REQUIRE(CountingDeleter::calls == 0);
+            REQUIRE(*copy == 42);
+        }
+        REQUIRE(CountingDeleter::calls == 1);
+
+        SharedPtr<int> sp(new int(1), &FreeInt);
+        sp.Reset(new int(2), [](int* ptr) { delete ptr; });
+        REQUIRE(*sp == 2);
+    }
+
+    SECTION("Stateful deleter") {
+        std::vector<int*> pool;
+        int values[2] = {1, 2};
+        SharedPtr<int> sp(&values[0], PoolDeleter{&pool});
+        sp.Reset(&values[1], PoolDeleter{&pool});
+        REQUIRE(pool == std::vector<int*>{&values[0]});
+        sp.Reset();
+        REQUIRE(pool == std::vector<int*>{&values[0], &values[1]});
+    }
+
+    SECTION("Arrays") {
+        SharedPtr<Ordered[]> sp(new Ordered[2], [](Ordered* ptr) { delete[] ptr; });
+        Ordered::destroyed.clear();
+        sp.Reset();
+        REQUIRE(Ordered::destroyed.size() == 2);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct Record {
+    Record(int id) : id(id) {
+        if (id == throw_at) {
+            throw std::runtime_error("Record");
+        }
+        ++alive;
+    }
+
+    ~Record() {
+        --alive;
+    }
+
+    int id;
+
+    inline static int alive = 0;
+    inline static int throw_at = -1;
+};
+
+TEST_CASE("MakeSharedBatch") {
+    SECTION("One allocation for the whole batch") {
+        auto batch = MakeSharedBatch<Record>(100, [](size_t i) { return i; });
+        REQUIRE(Record::alive == 100);
+        for (size_t i = 0; i < batch.size(); ++i) {
+            REQUIRE(batch[i]->id == static_cast<int>(i));
+            REQUIRE(batch[i].UseCount() == 1);
+        }
+
+        // The blocks lie one after another in the same allocation
+        auto* first = reinterpret_cast<char*>(batch[0].Get());
+        auto stride = reinterpret_cast<char*>(batch[1].Get()) - first;
+        for (size_t i = 1; i < batch.size(); ++i) {
+            REQUIRE(reinterpret_cast<char*>(batch[i].Get()) == first + i * stride);
+        }
+    }
+
+    SECTION("Freed with the last block") {
+        auto batch = MakeSharedBatch<Record, LocalCounter>(3, [](size_t i) { return 10 + i; });
+        LocalSharedPtr<Record> survivor = batch[1];
+        batch.clear();
+        REQUIRE(Record::alive == 1);
+        REQUIRE(survivor->id == 11);
+        survivor.Reset();
+        REQUIRE(Record::alive == 0);
+    }
+
+    SECTION("Factory throws") {
+        Record::throw_at = 5;
+        REQUIRE_THROWS_AS(MakeSharedBatch<Record>(10, [](size_t i) { return i; }),
+                          std::runtime_error);
+        Record::throw_at = -1;
+        REQUIRE(Record::alive == 0);
+    }
+
+    SECTION("Empty batch") {
+        EXPECT_ZERO_ALLOCATIONS(REQUIRE(MakeSharedBatch<Record>(0, [](size_t i) { return i; })
+                                            .empty()));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+struct Message {
+    Message(int type, bool fail = false) : type(type) {
+        if (fail) {
+            throw std::runtime_error("Message");
+        }
+    }
+
+    ~Message() {
+        Ordered::destroyed.push_back(-1);
+    }
+
+    int type;
+};
+
+TEST_CASE("MakeSharedWithTrailing") {
+    SECTION("Header and elements in one allocation") {
+        SharedPtr<Message> sp;
+        EXPECT_ONE_ALLOCATION(sp = MakeSharedWithTrailing<Message, int64_t>(5, 7));
+        REQUIRE(sp->type == 7);
+
+        auto payload = GetTrailing<int64_t>(sp);
+        REQUIRE(payload.size() == 5);
+        for (auto& value : payload) {
+            REQUIRE(value == 0);
+            value = 3;
+        }
+        REQUIRE(reinterpret_cast<char*>(payload.data()) > reinterpret_cast<char*>(sp.Get()));
+        REQUIRE(reinterpret_cast<uintptr_t>(payload.data()) % alignof(int64_t) == 0);
+
+        SharedPtr<const Message> copy = sp;
+        REQUIRE(GetTrailing<const int64_t>(copy)[4] == 3);
+
+        REQUIRE(GetTrailing<char>(MakeSharedWithTrailing<Message, char>(0, 1)).empty());
+    }
+
+    SECTION("Only the owner of the header sees the elements") {
+        auto sp = MakeSharedWithTrailing<Message, int>(3, 1);
+        SharedPtr<int> alias(sp, &sp->type);
+        REQUIRE(GetTrailing<int>(alias).empty());
+        REQUIRE(GetTrailing<char>(sp).empty());
+        REQUIRE(GetTrailing<int>(MakeShared<Message>(1)).empty());
+        REQUIRE(GetTrailing<int>(SharedPtr<Message>()).empty());
+    }
+
+    SECTION("Header first, then the elements in reverse order") {
+        auto sp = MakeSharedWithTrailing<Message, Ordered>(3, 1);
+        auto elements = GetTrailing<Ordered>(sp);
+        std::vector<int> expected = {-1, elements[2].id, elements[1].id, elements[0].id};
+        Ordered::destroyed.clear();
+        sp.Reset();
+        REQUIRE(Ordered::destroyed == expected);
+    }
+
+    SECTION("Header throws") {
+        Ordered::destroyed.clear();
+        REQUIRE_THROWS_AS((MakeSharedWithTrailing<Message, Ordered>(2, 1, true)),
+                          std::runtime_error);
+        REQUIRE(Ordered::destroyed.size() == 2);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <size_t kAlign>
+struct alignas(kAlign) Aligned {
+    Aligned() = default;
+
+    Aligned(int value) : value(value) {
+    }
+
+    int value = 0;
+};
+
+// Big enough for `MakeShared` to allocate it apart from the counts
+struct alignas(4096) AlignedPage {
+    char data[kSplitAllocationThreshold];
+};
+
+template <typename T>
+bool IsAligned(const T* ptr) {
+    return reinterpret_cast<uintptr_t>(ptr) % alignof(T) == 0;
+}
+
+TEMPLATE_TEST_CASE("Over-aligned objects", "", Aligned<32>, Aligned<64>, Aligned<4096>) {
+    // One lucky allocation proves little, so make several of each at once
+    constexpr int kCount = 8;
+    std::vector<SharedPtr<TestType>> owners;
+    std::vector<LocalSharedPtr<TestType>> local_owners;
+    for (int i = 0; i < kCount; ++i) {
+        owners.push_back(MakeShared<TestType>(i));
+        owners.push_back(MakeSharedForOverwrite<TestType>());
+        owners.push_back(MakeSharedIsolated<TestType>(i));
+        owners.push_back(AllocateShared<TestType>(std::allocator<TestType>(), i));
+        owners.push_back(MakeSharedWithTrailing<TestType, char>(3, i));
+        local_owners.push_back(MakeShared<TestType, LocalCounter>(i));
+    }
+    for (auto& owner : MakeSharedBatch<TestType>(kCount, [](size_t i) { return int(i); })) {
+        owners.push_back(owner);
+    }
+    for (const auto& owner : owners) {
+        REQUIRE(IsAligned(owner.Get()));
+    }
+    for (const auto& owner : local_owners) {
+        REQUIRE(IsAligned(owner.Get()));
+    }
+    REQUIRE(owners[0]->value == 0);
+    REQUIRE(owners[5]->value == 1);
+
+    auto array = MakeShared<TestType[]>(kCount);
+    for (int i = 0; i < kCount; ++i) {
+        REQUIRE(IsAligned(&array[i]));
+    }
+}
+
+TEST_CASE("Over-aligned big objects") {
+    static_assert(kSplitAllocation<AlignedPage>);
+    auto sp = MakeShared<AlignedPage>();
+    REQUIRE(IsAligned(sp.Get()));
+    REQUIRE(sp->data[0] == 0);
+}
@@ -0,0 +1,111 @@
+#include "side_table.h"
+#include "tracked.h"
+#include "weak.h"
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+using Node = TrackedNode<SideTableCounter>;
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Side table layout") {
+    static_assert(sizeof(ControlBlockBase<SideTableCounter>) == 2 * sizeof(void*));
+    static_assert(sizeof(ControlBlockMS<int64_t, SideTableCounter>) == 3 * sizeof(void*));
+}
+
+TEST_CASE("No weak references") {
+    EXPECT_ONE_ALLOCATION({
+        auto sp = MakeSideTableShared<Tracked>();
+        SideTableSharedPtr<Tracked> copy = sp;
+        REQUIRE(sp.UseCount() == 2);
+        REQUIRE(sp.GetBlock()->GetRefWCount() == 1);
+        REQUIRE(!sp.GetBlock()->HasSideTable());
+    });
+    REQUIRE(Tracked::alive == 0);
+}
+
+TEST_CASE("Side table on the first weak reference") {
+    auto sp = MakeSideTableShared<Tracked>();
+    SideTableSharedPtr<Tracked> copy = sp;
+
+    SideTableWeakPtr<Tracked> weak;
+    EXPECT_ONE_ALLOCATION(weak = sp);
+    REQUIRE(sp.GetBlock()->HasSideTable());
+    REQUIRE(sp.UseCount() == 2);
+    REQUIRE(weak.UseCount() == 2);
+
+    EXPECT_ZERO_ALLOCATIONS({
+        SideTableWeakPtr<Tracked> other = weak;
+        REQUIRE(sp.GetBlock()->GetRefWCount() == 3);
+        REQUIRE(other.Lock()->value == 42);
+    });
+
+    copy.Reset();
+    sp.Reset();
+    REQUIRE(Tracked::alive == 0);
+    REQUIRE(weak.Expired());
+    REQUIRE(weak.TryLock().Get() == nullptr);
+    REQUIRE_THROWS_AS(SideTableSharedPtr<Tracked>(weak), BadWeakPtr);
+}
+
+TEST_CASE("Weak pointer made from a side table owner") {
+    auto sp = MakeSideTableShared<Tracked>();
+    EXPECT_ONE_ALLOCATION({
+        SideTableWeakPtr<Tracked> weak(sp);
+        REQUIRE(sp.GetBlock()->HasSideTable());
+        REQUIRE(sp.GetBlock()->GetRefWCount() == 2);
+        REQUIRE(weak.Lock() == sp);
+    });
+    REQUIRE(sp.GetBlock()->GetRefWCount() == 1);
+
+    SideTableWeakPtr<Tracked> weak(sp);
+    sp.Reset();
+    REQUIRE(Tracked::alive == 0);
+    REQUIRE(weak.Expired());
+}
+
+TEST_CASE("Side table for SharedFromThis") {
+    Node* ptr = new Node;
+    SideTableSharedPtr<Node> node(ptr);
+    REQUIRE(node.GetBlock()->HasSideTable());
+    REQUIRE(ptr->SharedFromThis() == node);
+    REQUIRE(node.UseCount() == 1);
+}
+
+TEST_CASE("Side table made while other threads count") {
+    constexpr int kThreads = 8;
+    constexpr int kIterations = 10'000;
+
+    auto sp = MakeSideTableShared<Tracked>();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([owner = sp, i] {
+            for (int j = 0; j < kIterations; ++j) {
+                SideTableSharedPtr<Tracked> copy = owner;
+                if (j == i * 1000) {
+                    SideTableWeakPtr<Tracked> weak = copy;
+                    weak.TryLock();
+                }
+            }
+        });
+    }
+    SideTableWeakPtr<Tracked> weak = sp;
+    sp.Reset();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(Tracked::alive == 0);
+    REQUIRE(weak.GetBlock()->GetRefWCount() == 1);
+}
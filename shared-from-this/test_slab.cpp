@@ -0,0 +1,113 @@
+#include "shared.h"
+#include "weak.h"
+
+#include <common/slab.h>
+#include <intrusive/intrusive.h>
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <cstdint>
+#include <set>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Intrusive : SimpleRefCounted<Intrusive>, SlabAllocated {
+    int value = 42;
+};
+
+struct alignas(64) Wide {
+    char data[64];
+};
+
+struct alignas(4096) Page {
+    char data[64];
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Slab size classes") {
+    std::set<void*> seen;
+    std::vector<void*> objects;
+    for (size_t size : {1, 16, 17, 100, 512}) {
+        for (int i = 0; i < 1000; ++i) {
+            void* ptr = SlabAllocator::Allocate(size);
+            REQUIRE(reinterpret_cast<uintptr_t>(ptr) % SlabAllocator::kGranularity == 0);
+            REQUIRE(seen.insert(ptr).second);
+            objects.push_back(ptr);
+        }
+        for (void* ptr : objects) {
+            SlabAllocator::Deallocate(ptr, size);
+        }
+        objects.clear();
+        seen.clear();
+    }
+
+    // Freed objects are reused by the same thread
+    void* first = SlabAllocator::Allocate(48);
+    SlabAllocator::Deallocate(first, 48);
+    REQUIRE(SlabAllocator::Allocate(48) == first);
+    SlabAllocator::Deallocate(first, 48);
+
+    // Big requests fall back to the global allocator
+    EXPECT_ONE_ALLOCATION(SlabAllocator::Deallocate(SlabAllocator::Allocate(4096), 4096));
+}
+
+TEST_CASE("Blocks come from the slab") {
+    // The first object of each size class carves a slab
+    auto sp = MakeSlabShared<int>(1);
+    SlabSharedPtr<int> from_pointer(new int(1));
+    auto intrusive = MakeIntrusive<Intrusive>();
+
+    EXPECT_ZERO_ALLOCATIONS({
+        auto other = MakeSlabShared<int>(2);
+        SlabWeakPtr<int> weak = other;
+        REQUIRE(*weak.Lock() == 2);
+    });
+    int* raw = new int(3);
+    EXPECT_ZERO_ALLOCATIONS(SlabSharedPtr<int>(raw).Reset());
+    EXPECT_ZERO_ALLOCATIONS(REQUIRE(MakeIntrusive<Intrusive>()->value == 42));
+
+    // Over-aligned blocks keep the global allocator
+    auto wide = MakeSharedIsolated<Wide, SlabCounter<AtomicCounter>>();
+    REQUIRE(reinterpret_cast<uintptr_t>(wide.Get()) % alignof(Wide) == 0);
+    auto page = MakeSlabShared<Page>();
+    REQUIRE(reinterpret_cast<uintptr_t>(page.Get()) % alignof(Page) == 0);
+
+    // Other owners keep the global allocator
+    EXPECT_ONE_ALLOCATION(MakeShared<int>(4));
+    EXPECT_ONE_ALLOCATION(MakeLocalShared<int>(5));
+}
+
+TEST_CASE("Slab objects freed by other threads") {
+    constexpr int kThreads = 4;
+    constexpr int kObjects = 5'000;
+
+    std::vector<std::vector<SlabSharedPtr<int>>> batches(kThreads);
+    for (int i = 0; i < kThreads; ++i) {
+        for (int j = 0; j < kObjects; ++j) {
+            batches[i].push_back(MakeSlabShared<int>(j));
+        }
+    }
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back([batch = std::move(batches[i])]() mutable {
+            batch.clear();
+            for (int j = 0; j < kObjects; ++j) {
+                auto sp = MakeSlabShared<int>(j);
+                auto ip = MakeIntrusive<Intrusive>();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(*MakeSlabShared<int>(7) == 7);
+}
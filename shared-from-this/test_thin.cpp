@@ -0,0 +1,101 @@
+#include "thin.h"
+#include "weak.h"
+
+#include <catch.hpp>
+
+#include "allocations_checker.h"
+
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+struct Node : EnableSharedFromThis<Node> {
+    int value = 42;
+};
+
+struct Pair {
+    int first;
+    int second;
+};
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Thin footprint") {
+    static_assert(sizeof(ThinSharedPtr<int>) == sizeof(void*));
+    static_assert(sizeof(ThinSharedPtr<std::string>) == sizeof(void*));
+    static_assert(sizeof(ThinSharedPtr<int, LocalCounter>) == sizeof(void*));
+    static_assert(sizeof(ThinSharedPtr<int>) * 2 == sizeof(SharedPtr<int>));
+
+    std::vector<ThinSharedPtr<int>> values;
+    for (int i = 0; i < 10; ++i) {
+        values.push_back(MakeThinShared<int>(i));
+    }
+    auto copy = values;
+    REQUIRE(*copy[7] == 7);
+    REQUIRE(values[7].UseCount() == 2);
+}
+
+TEST_CASE("Thin basics") {
+    ThinSharedPtr<std::string> empty;
+    REQUIRE(!empty);
+    REQUIRE(empty.Get() == nullptr);
+    REQUIRE(empty.UseCount() == 0);
+
+    auto sp = MakeThinShared<std::string>("thin");
+    REQUIRE(*sp == "thin");
+    REQUIRE(sp->size() == 4);
+
+    ThinSharedPtr<std::string> copy = sp;
+    REQUIRE(copy == sp);
+    REQUIRE(sp.UseCount() == 2);
+    ThinSharedPtr<std::string> moved = std::move(copy);
+    REQUIRE(!copy);
+    REQUIRE(sp.UseCount() == 2);
+    moved.Reset();
+    REQUIRE(sp.UseCount() == 1);
+    empty = sp;
+    REQUIRE(sp.UseCount() == 2);
+}
+
+TEST_CASE("Thin conversions") {
+    auto sp = MakeShared<Pair>(Pair{1, 2});
+
+    ThinSharedPtr<Pair> thin(sp);
+    REQUIRE(thin.Get() == sp.Get());
+    REQUIRE(sp.UseCount() == 2);
+
+    SharedPtr<Pair> back = thin;
+    REQUIRE(back == sp);
+    REQUIRE(sp.UseCount() == 3);
+
+    EXPECT_ZERO_ALLOCATIONS({
+        SharedPtr<Pair> moved_back = std::move(thin);
+        REQUIRE(!thin);
+        REQUIRE(sp.UseCount() == 3);
+        ThinSharedPtr<Pair> moved(std::move(moved_back));
+        REQUIRE(!moved_back);
+        REQUIRE(moved->second == 2);
+        REQUIRE(sp.UseCount() == 3);
+    });
+
+    // Only whole `MakeShared` objects can go thin
+    REQUIRE_THROWS_AS(ThinSharedPtr<Pair>(SharedPtr<Pair>(new Pair{3, 4})), BadThinPtr);
+    SharedPtr<int> member(sp, &sp->second);
+    REQUIRE_THROWS_AS(ThinSharedPtr<int>(member), BadThinPtr);
+    REQUIRE(!ThinSharedPtr<int>(SharedPtr<int>()));
+}
+
+TEST_CASE("Thin SharedFromThis") {
+    auto node = MakeThinShared<Node>();
+    REQUIRE(node->SharedFromThis().Get() == node.Get());
+    REQUIRE(node.UseCount() == 1);
+
+    WeakPtr<Node> weak = node->WeakFromThis();
+    node.Reset();
+    REQUIRE(weak.Expired());
+}
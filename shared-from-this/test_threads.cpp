@@ -0,0 +1,139 @@
+#include "shared.h"
+#include "tracked.h"
+#include "weak.h"
+
+#include <catch.hpp>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace {
+
+using Node = TrackedNode<>;
+
+constexpr int kThreads = 8;
+constexpr int kIterations = 100'000;
+
+template <typename F>
+void RunInThreads(F func) {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < kThreads; ++i) {
+        threads.emplace_back(func);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+}  // namespace
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_CASE("Concurrent copies") {
+    Tracked::destroyed = 0;
+    std::atomic<int> bad_reads = 0;
+    {
+        auto sp = MakeShared<Tracked>();
+        RunInThreads([&sp, &bad_reads] {
+            for (int i = 0; i < kIterations; ++i) {
+                SharedPtr<Tracked> copy(sp);
+                SharedPtr<Tracked> other = copy;
+                if (other->value != 42) {
+                    ++bad_reads;
+                }
+            }
+        });
+        REQUIRE(sp.UseCount() == 1);
+    }
+    REQUIRE(bad_reads == 0);
+    REQUIRE(Tracked::alive == 0);
+    REQUIRE(Tracked::destroyed == 1);
+}
+
+TEST_CASE("Last owner in another thread") {
+    Tracked::destroyed = 0;
+    std::atomic<int> bad_reads = 0;
+    for (int round = 0; round < 1'000; ++round) {
+        SharedPtr<Tracked> sp(new Tracked);
+        std::vector<SharedPtr<Tracked>> copies(kThreads, sp);
+        sp.Reset();
+
+        std::vector<std::thread> threads;
+        for (auto& copy : copies) {
+            threads.emplace_back([owner = std::move(copy), &bad_reads]() mutable {
+                if (owner->value != 42) {
+                    ++bad_reads;
+                }
+                owner.Reset();
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    REQUIRE(bad_reads == 0);
+    REQUIRE(Tracked::alive == 0);
+    REQUIRE(Tracked::destroyed == 1'000);
+}
+
+TEST_CASE("Weak references racing with the last owner") {
+    Tracked::destroyed = 0;
+    for (int round = 0; round < 1'000; ++round) {
+        auto sp = MakeShared<Tracked>();
+        std::vector<SharedPtr<Tracked>> copies(kThreads, sp);
+        sp.Reset();
+
+        std::vector<std::thread> threads;
+        for (auto& copy : copies) {
+            threads.emplace_back([owner = std::move(copy)]() mutable {
+                WeakPtr<Tracked> weak(owner);
+                WeakPtr<Tracked> other = weak;
+                owner.Reset();
+                other.Reset();
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+    REQUIRE(Tracked::alive == 0);
+    REQUIRE(Tracked::destroyed == 1'000);
+}
+
+TEST_CASE("TryLock racing with the last owner") {
+    Tracked::destroyed = 0;
+    std::atomic<int> bad_reads = 0;
+    for (int round = 0; round < 1'000; ++round) {
+        auto sp = MakeShared<Tracked>();
+        WeakPtr<Tracked> weak(sp);
+        std::thread owner([sp = std::move(sp)]() mutable { sp.Reset(); });
+        RunInThreads([&weak, &bad_reads] {
+            if (auto locked = weak.TryLock(); locked && locked->value != 42) {
+                ++bad_reads;
+            }
+        });
+        owner.join();
+        REQUIRE(weak.Expired());
+    }
+    REQUIRE(bad_reads == 0);
+    REQUIRE(Tracked::alive == 0);
+    REQUIRE(Tracked::destroyed == 1'000);
+}
+
+TEST_CASE("Concurrent SharedFromThis") {
+    std::atomic<int> bad_reads = 0;
+    auto sp = MakeShared<Node>();
+    RunInThreads([&sp, &bad_reads] {
+        for (int i = 0; i < kIterations; ++i) {
+            SharedPtr<Node> self = sp->SharedFromThis();
+            if (self.Get() != sp.Get() || self->value != 42) {
+                ++bad_reads;
+            }
+        }
+    });
+    REQUIRE(bad_reads == 0);
+    REQUIRE(sp.UseCount() == 1);
+}
@@ -147,6 +147,24 @@ TEST_CASE("Shared from invalid Weak") {
     REQUIRE_THROWS_AS(SharedPtr<int>(w_ptr), BadWeakPtr);
 }
 
+TEST_CASE("TryLock") {
+    WeakPtr<int> empty;
+    static_assert(noexcept(empty.TryLock()));
+    REQUIRE(empty.TryLock().Get() == nullptr);
+    REQUIRE_THROWS_AS(SharedPtr<int>(empty), BadWeakPtr);
+
+    WeakPtr<int> weak;
+    {
+        auto sp = MakeShared<int>(42);
+        weak = sp;
+        auto locked = weak.TryLock();
+        REQUIRE(*locked == 42);
+        REQUIRE(sp.UseCount() == 2);
+    }
+    REQUIRE(weak.TryLock().Get() == nullptr);
+    REQUIRE(weak.UseCount() == 0);
+}
+
 TEST_CASE("Constness") {
     SharedPtr<int> sp(new int(42));
     WeakPtr<const int> wp(sp);
@@ -175,3 +193,76 @@ TEST_CASE("Lifetimes") {
         delete wp;
     }
 }
+
+namespace {
+
+struct BigEntry {
+    explicit BigEntry(char fill) {
+        data[0] = fill;
+    }
+
+    static void* operator new(size_t size) {
+        live_bytes += size;
+        return ::operator new(size);
+    }
+
+    static void operator delete(void* ptr, size_t size) {
+        live_bytes -= size;
+        ::operator delete(ptr);
+    }
+
+    char data[kSplitAllocationThreshold];
+
+    inline static size_t live_bytes = 0;
+};
+
+}  // namespace
+
+TEST_CASE("Weak references do not pin big objects") {
+    static_assert(!kSplitAllocation<int>);
+    static_assert(kSplitAllocation<BigEntry>);
+
+    auto small = MakeShared<int>(1);
+    REQUIRE(reinterpret_cast<char*>(small.Get()) - reinterpret_cast<char*>(small.GetBlock()) <
+            static_cast<ptrdiff_t>(kCacheLineSize));
+
+    auto sp = MakeShared<BigEntry>('x');
+    REQUIRE(sp->data[0] == 'x');
+    REQUIRE(BigEntry::live_bytes == sizeof(BigEntry));
+
+    WeakPtr<BigEntry> weak = sp;
+    sp.Reset();
+    REQUIRE(weak.Expired());
+    REQUIRE(BigEntry::live_bytes == 0);
+}
+
+TEST_CASE("Weak arrays") {
+    auto sp = MakeShared<int[]>(3, 5);
+    WeakPtr<int[]> weak = sp;
+    REQUIRE(weak.Lock()[2] == 5);
+    sp.Reset();
+    REQUIRE(weak.Expired());
+}
+
+namespace {
+
+struct BatchNode : EnableSharedFromThis<BatchNode> {
+    BatchNode(int value) : value(value) {
+    }
+
+    int value;
+};
+
+}  // namespace
+
+TEST_CASE("Weak references into a batch") {
+    auto batch = MakeSharedBatch<BatchNode>(3, [](size_t i) { return static_cast<int>(i); });
+    REQUIRE(batch[1]->SharedFromThis() == batch[1]);
+    REQUIRE(batch[1].UseCount() == 1);
+
+    // Weak references keep the memory, not the objects
+    WeakPtr<BatchNode> weak = batch[2];
+    batch.clear();
+    REQUIRE(weak.Expired());
+    REQUIRE(weak.TryLock().Get() == nullptr);
+}
@@ -0,0 +1,138 @@
+#pragma once
+
+#include "shared.h"
+
+#include <cstddef>
+#include <exception>
+#include <utility>
+
+class BadThinPtr : public std::exception {};
+
+// One-word owner of an object made by `MakeShared`
+//
+// Only the block is stored; the object sits at a fixed offset inside it. There is no aliasing and
+// no conversion between types, and only owners of `ControlBlockMS<T, Counter>` blocks can become
+// thin. Going back to `SharedPtr` never fails.
+template <typename T, typename Counter>
+class ThinSharedPtr {
+public:
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Constructors
+
+    ThinSharedPtr() = default;
+
+    ThinSharedPtr(std::nullptr_t) {
+    }
+
+    ThinSharedPtr(const ThinSharedPtr& other) noexcept : block_(other.block_) {
+        if (block_ != nullptr) {
+            block_->AddRef();
+        }
+    }
+
+    ThinSharedPtr(ThinSharedPtr&& other) noexcept : block_(std::exchange(other.block_, nullptr)) {
+    }
+
+    // Throws `BadThinPtr` unless `other` owns the whole object of a `MakeShared` block; objects
+    // big enough to be split from their counts have no such block
+    explicit ThinSharedPtr(const SharedPtr<T, Counter>& other) : block_(Adopt(other)) {
+        if (block_ != nullptr) {
+            block_->AddRef();
+        }
+    }
+
+    // Takes over the reference of `other` without touching the counter
+    explicit ThinSharedPtr(SharedPtr<T, Counter>&& other) : block_(Adopt(other)) {
+        other.data_ = nullptr;
+        other.ptr_ = nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // `operator=`-s
+
+    ThinSharedPtr& operator=(ThinSharedPtr other) noexcept {
+        Swap(other);
+        return *this;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Destructor
+
+    ~ThinSharedPtr() {
+        if (block_ != nullptr) {
+            block_->RemRef();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Modifiers
+
+    void Reset() {
+        ThinSharedPtr().Swap(*this);
+    }
+
+    void Swap(ThinSharedPtr& other) noexcept {
+        std::swap(block_, other.block_);
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Observers
+
+    T* Get() const {
+        return block_ != nullptr ? block_->GetPtr() : nullptr;
+    }
+    T& operator*() const {
+        return *block_->GetPtr();
+    }
+    T* operator->() const {
+        return block_->GetPtr();
+    }
+    size_t UseCount() const {
+        return block_ != nullptr ? block_->GetRefCount() : 0;
+    }
+    explicit operator bool() const {
+        return block_ != nullptr;
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////////////////////
+    // Conversions
+
+    operator SharedPtr<T, Counter>() const& {
+        return ThinSharedPtr(*this);
+    }
+
+    operator SharedPtr<T, Counter>() && {
+        auto* block = std::exchange(block_, nullptr);
+        return SharedPtr<T, Counter>(block, block != nullptr ? block->GetPtr() : nullptr);
+    }
+
+private:
+    static ControlBlockMS<T, Counter>* Adopt(const SharedPtr<T, Counter>& other) {
+        if (!other) {
+            return nullptr;
+        }
+        auto* block = ControlBlockMS<T, Counter>::FromBase(other.GetBlock());
+        if (block == nullptr || block->GetPtr() != other.Get()) {
+            throw BadThinPtr();
+        }
+        return block;
+    }
+
+    ControlBlockMS<T, Counter>* block_ = nullptr;
+};
+
+template <typename T, typename Counter>
+struct IsTriviallyRelocatable<ThinSharedPtr<T, Counter>> : std::true_type {};
+
+template <typename T, typename Counter>
+inline bool operator==(const ThinSharedPtr<T, Counter>& left,
+                       const ThinSharedPtr<T, Counter>& right) {
+    return left.Get() == right.Get();
+}
+
+// Allocate memory only once, whatever the size of the object
+template <typename T, typename Counter = AtomicCounter, typename... Args>
+ThinSharedPtr<T, Counter> MakeThinShared(Args&&... args) {
+    auto* block = new ControlBlockMS<T, Counter>(std::forward<Args>(args)...);
+    return ThinSharedPtr<T, Counter>(SharedPtr<T, Counter>(block));
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "shared.h"
+
+#include <atomic>
+
+// Fixtures shared by the tests of the counter policies
+
+// Counts the objects alive and destroyed so far
+struct Tracked {
+    Tracked() {
+        alive.fetch_add(1);
+    }
+
+    ~Tracked() {
+        alive.fetch_sub(1);
+        destroyed.fetch_add(1);
+    }
+
+    int value = 42;
+
+    inline static std::atomic<int> alive = 0;
+    inline static std::atomic<int> destroyed = 0;
+};
+
+// Object that finds its owner through blocks counted with `Counter`
+template <typename Counter = AtomicCounter>
+struct TrackedNode : EnableSharedFromThis<TrackedNode<Counter>, Counter> {
+    int value = 42;
+};
@@ -2,33 +2,39 @@
 
 #include "sw_fwd.h"  // Forward declaration
 
+#include <utility>
+
 // https://en.cppreference.com/w/cpp/memory/weak_ptr
-template <typename T>
+template <typename T, typename Counter>
 class WeakPtr {
 public:
+    using ElementType = std::remove_extent_t<T>;
+
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
-    WeakPtr() : data_(nullptr), ptr_(nullptr) {
+    WeakPtr() noexcept : data_(nullptr), ptr_(nullptr) {
     }
 
-    template<typename U>
-    WeakPtr(const WeakPtr<U>& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
+    template <typename U, typename = EnableIfCompatible<U, T>>
+    WeakPtr(const WeakPtr<U, Counter>& other) noexcept
+        : data_(other.GetBlock()), ptr_(other.Get()) {
         CheckAdd();
     }
     WeakPtr(const WeakPtr& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
         CheckAdd();
     }
-    template <typename P>
-    WeakPtr(WeakPtr<P>&& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
-        CheckAdd();
-        other.Reset();
+    // Moves take the reference over and leave the counts alone
+    template <typename P, typename = EnableIfCompatible<P, T>>
+    WeakPtr(WeakPtr<P, Counter>&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), ptr_(std::exchange(other.ptr_, nullptr)) {
     }
 
     // Demote `SharedPtr`
     // #2 from https://en.cppreference.com/w/cpp/memory/weak_ptr/weak_ptr
-    template <typename U>
-    WeakPtr(const SharedPtr<U>& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
+    template <typename U, typename = EnableIfCompatible<U, T>>
+    WeakPtr(const SharedPtr<U, Counter>& other) noexcept
+        : data_(other.GetBlock()), ptr_(other.Get()) {
         CheckAdd();
     }
 
@@ -43,12 +49,9 @@ public:
         return *this;
     }
 
-    WeakPtr& operator=(WeakPtr&& other) noexcept {
-        DelChecking();
-        data_ = other.GetBlock();
-        ptr_ = other.Get();
-        CheckAdd();
-        other.Reset();
+    template <typename P, typename = EnableIfCompatible<P, T>>
+    WeakPtr& operator=(WeakPtr<P, Counter>&& other) noexcept {
+        WeakPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
@@ -56,23 +59,18 @@ public:
     // Destructor
 
     ~WeakPtr() {
-        if (data_ != nullptr) {
-            data_->RemRefW();
-            if (data_->GetRefCount() == 0 && data_->GetRefWCount() == 0) {
-                delete data_;
-            }
-        }
+        DelChecking();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
 
-    void Reset() {
+    void Reset() noexcept {
         DelChecking();
         data_ = nullptr;
         ptr_ = nullptr;
     }
-    void Swap(WeakPtr& other) {
+    void Swap(WeakPtr& other) noexcept {
         std::swap(data_, other.data_);
         std::swap(ptr_, other.ptr_);
     }
@@ -83,9 +81,6 @@ public:
     void DelChecking() {
         if (data_ != nullptr) {
             data_->RemRefW();
-            if (data_->GetRefCount() == 0 && data_->GetRefWCount() == 0) {
-                delete data_;
-            }
         }
     }
 
@@ -94,16 +89,16 @@ public:
             data_->AddRefW();
         }
     }
-    T* Get() const {
+    ElementType* Get() const {
         return ptr_;
     }
-    ControlBlockBase* GetBlock() const {
+    ControlBlockBase<Counter>* GetBlock() const {
         return data_;
     }
-    T& operator*() const {
+    ElementType& operator*() const {
         return *ptr_;
     }
-    T* operator->() const {
+    ElementType* operator->() const {
         return ptr_;
     }
     size_t UseCount() const {
@@ -112,11 +107,24 @@ public:
     bool Expired() const {
         return (data_ == nullptr) ? true : (data_->GetRefCount() == 0);
     }
-    SharedPtr<T> Lock() const {
-        return Expired() ? SharedPtr<T>() : SharedPtr<T>(*this);
+    // Upgrades with a single increment-if-nonzero, so it cannot race with the last owner
+    SharedPtr<T, Counter> TryLock() const noexcept {
+        if (data_ != nullptr && data_->TryAddRef()) {
+            return SharedPtr<T, Counter>(data_, ptr_);
+        }
+        return SharedPtr<T, Counter>();
+    }
+    SharedPtr<T, Counter> Lock() const noexcept {
+        return TryLock();
     }
 
 private:
-    ControlBlockBase* data_ = nullptr;
-    T* ptr_ = nullptr;
+    template <typename U, typename C>
+    friend class WeakPtr;
+
+    ControlBlockBase<Counter>* data_ = nullptr;
+    ElementType* ptr_ = nullptr;
 };
+
+template <typename T, typename Counter>
+struct IsTriviallyRelocatable<WeakPtr<T, Counter>> : std::true_type {};
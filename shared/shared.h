@@ -5,101 +5,127 @@
 #include <cstddef>
 #include "bits/stdc++.h"
 
+// Control blocks have no vtable: the concrete block passes the function that destroys it to the
+// base, which calls it when the last owner is gone
+template <typename Counter>
 struct ControlBlockBase {
+    using Destroyer = void (*)(ControlBlockBase*);
+
+    explicit ControlBlockBase(Destroyer destroyer) : destroyer_(destroyer) {
+    }
+
     size_t GetRefCount() const {
-        return ref_counter_;
+        return ref_counter_.RefCount();
     }
 
     void AddRef() {
-        ++ref_counter_;
+        ref_counter_.IncRef();
     }
 
     void RemRef() {
-        --ref_counter_;
-    }
-
-    virtual ~ControlBlockBase() {
+        if (ref_counter_.DecRef() == 0) {
+            destroyer_(this);
+        }
     }
 
 protected:
-    size_t ref_counter_ = 1;
+    // Blocks are freed only by their destroyer, which knows the concrete type
+    ~ControlBlockBase() = default;
+
+    Destroyer destroyer_;
+    Counter ref_counter_{1};
 };
 
-template <typename T>
-struct ControlBlockUs : ControlBlockBase {
-    ControlBlockUs(T* ptr) {
+template <typename T, typename Counter>
+struct ControlBlockUs : ControlBlockBase<Counter> {
+    ControlBlockUs(T* ptr) : ControlBlockBase<Counter>(&Destroy) {
         ptr_ = ptr;
-        ref_counter_ = 1;
     }
 
-    ~ControlBlockUs() override {
+    ~ControlBlockUs() {
         delete ptr_;
     }
 
 private:
+    static void Destroy(ControlBlockBase<Counter>* base) {
+        delete static_cast<ControlBlockUs*>(base);
+    }
+
     T* ptr_;
 };
 
-template <typename T>
-struct ControlBlockMS : ControlBlockBase {
+template <typename T, typename Counter>
+struct ControlBlockMS : ControlBlockBase<Counter> {
     template <typename... Arg>
-    ControlBlockMS(Arg&&... args) {
+    ControlBlockMS(Arg&&... args) : ControlBlockBase<Counter>(&Destroy) {
         new (&storage_) T(std::forward<Arg>(args)...);
     }
     T* GetPtr() {
         return reinterpret_cast<T*>(&storage_);
     }
-    ~ControlBlockMS() override {
+    ~ControlBlockMS() {
         GetPtr()->~T();
     }
 
 private:
+    static void Destroy(ControlBlockBase<Counter>* base) {
+        delete static_cast<ControlBlockMS*>(base);
+    }
+
     std::aligned_storage_t<sizeof(T), alignof(T)> storage_;
 };
 
-template <typename T>
+template <typename T, typename Counter>
 class SharedPtr {
 public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
-    SharedPtr() : data_(nullptr), ptr_(nullptr) {
+    SharedPtr() noexcept : data_(nullptr), ptr_(nullptr) {
     }
 
-    SharedPtr(std::nullptr_t) : data_(nullptr), ptr_(nullptr) {
+    SharedPtr(std::nullptr_t) noexcept : data_(nullptr), ptr_(nullptr) {
     }
 
+    // If the block cannot be allocated, `ptr` is deleted before the exception leaves
     template <typename P>
-    explicit SharedPtr(P* ptr) noexcept : data_(new ControlBlockUs(ptr)), ptr_(ptr) {
+    explicit SharedPtr(P* ptr) : data_(nullptr), ptr_(ptr) {
+        try {
+            data_ = new ControlBlockUs<P, Counter>(ptr);
+        } catch (...) {
+            delete ptr;
+            throw;
+        }
     }
 
     SharedPtr(const SharedPtr& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
         CheckAdd();
     }
     template <typename P>
-    SharedPtr(SharedPtr<P>& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
+    SharedPtr(SharedPtr<P, Counter>& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
         CheckAdd();
     }
 
+    // Moves take the reference over and leave the counts alone
     template <typename P>
-    SharedPtr(SharedPtr<P>&& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
-        CheckAdd();
-        other.Reset();
+    SharedPtr(SharedPtr<P, Counter>&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), ptr_(std::exchange(other.ptr_, nullptr)) {
     }
 
-    SharedPtr(ControlBlockMS<T>* el) noexcept : data_(el), ptr_(el->GetPtr()) {
+    SharedPtr(ControlBlockMS<T, Counter>* el) noexcept : data_(el), ptr_(el->GetPtr()) {
     }
 
     // Aliasing constructor
     // #8 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
     template <typename Y>
-    SharedPtr(const SharedPtr<Y>& other, T* ptr) noexcept : data_(other.GetBlock()), ptr_(ptr) {
+    SharedPtr(const SharedPtr<Y, Counter>& other, T* ptr) noexcept
+        : data_(other.GetBlock()), ptr_(ptr) {
         CheckAdd();
     }
 
     // Promote `WeakPtr`
     // #11 from https://en.cppreference.com/w/cpp/memory/shared_ptr/shared_ptr
-    explicit SharedPtr(const WeakPtr<T>& other);
+    explicit SharedPtr(const WeakPtr<T, Counter>& other);
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // `operator=`-s
@@ -112,12 +138,8 @@ public:
         return *this;
     }
     template <typename P>
-    SharedPtr& operator=(SharedPtr<P>&& other) noexcept {
-        DelChecking();
-        data_ = other.GetBlock();
-        ptr_ = other.Get();
-        CheckAdd();
-        other.Reset();
+    SharedPtr& operator=(SharedPtr<P, Counter>&& other) noexcept {
+        SharedPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
@@ -131,18 +153,16 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
 
-    void Reset() {
+    void Reset() noexcept {
         DelChecking();
         data_ = nullptr;
         ptr_ = nullptr;
     }
     template <typename P>
     void Reset(P* ptr) {
-        DelChecking();
-        data_ = new ControlBlockUs<P>(ptr);
-        ptr_ = ptr;
+        SharedPtr(ptr).Swap(*this);
     }
-    void Swap(SharedPtr& other) {
+    void Swap(SharedPtr& other) noexcept {
         std::swap(data_, other.data_);
         std::swap(ptr_, other.ptr_);
     }
@@ -152,9 +172,6 @@ public:
     void DelChecking() {
         if (data_ != nullptr) {
             data_->RemRef();
-            if (data_->GetRefCount() == 0) {
-                delete data_;
-            }
         }
     }
 
@@ -166,7 +183,7 @@ public:
     T* Get() const {
         return ptr_;
     }
-    ControlBlockBase* GetBlock() const {
+    ControlBlockBase<Counter>* GetBlock() const {
         return data_;
     }
     T& operator*() const {
@@ -186,27 +203,39 @@ public:
     }
 
 private:
-    ControlBlockBase* data_ = nullptr;
+    template <typename U, typename C>
+    friend class SharedPtr;
+
+    ControlBlockBase<Counter>* data_ = nullptr;
     T* ptr_ = nullptr;
 };
 
-template <typename T, typename U>
-inline bool operator==(const SharedPtr<T>& left, const SharedPtr<U>& right);
+// Owners hold the block and the object but never their own address
+template <typename T, typename Counter>
+struct IsTriviallyRelocatable<SharedPtr<T, Counter>> : std::true_type {};
+
+template <typename T, typename U, typename Counter>
+inline bool operator==(const SharedPtr<T, Counter>& left, const SharedPtr<U, Counter>& right);
 
 // Allocate memory only once
+template <typename T, typename Counter = AtomicCounter, typename... Args>
+SharedPtr<T, Counter> MakeShared(Args&&... args) {
+    auto* block = new ControlBlockMS<T, Counter>(std::forward<Args>(args)...);
+    return SharedPtr<T, Counter>(block);
+}
+
 template <typename T, typename... Args>
-SharedPtr<T> MakeShared(Args&&... args) {
-    ControlBlockMS<T>* block = new ControlBlockMS<T>(std::forward<Args>(args)...);
-    return SharedPtr<T>(block);
+LocalSharedPtr<T> MakeLocalShared(Args&&... args) {
+    return MakeShared<T, LocalCounter>(std::forward<Args>(args)...);
 }
 
 // Look for usage examples in tests
-template <typename T>
+template <typename T, typename Counter = AtomicCounter>
 class EnableSharedFromThis {
 public:
-    SharedPtr<T> SharedFromThis();
-    SharedPtr<const T> SharedFromThis() const;
+    SharedPtr<T, Counter> SharedFromThis();
+    SharedPtr<const T, Counter> SharedFromThis() const;
 
-    WeakPtr<T> WeakFromThis() noexcept;
-    WeakPtr<const T> WeakFromThis() const noexcept;
+    WeakPtr<T, Counter> WeakFromThis() noexcept;
+    WeakPtr<const T, Counter> WeakFromThis() const noexcept;
 };
@@ -1,11 +1,70 @@
 #pragma once
 
+#include <common/relocation.h>
+
+#include <atomic>
+#include <cstddef>
 #include <exception>
 
 class BadWeakPtr : public std::exception {};
 
-template <typename T>
+// Counter for object graphs that never leave one thread
+class LocalCounter {
+public:
+    explicit LocalCounter(size_t count) : count_(count) {
+    }
+
+    size_t IncRef() {
+        return ++count_;
+    }
+
+    size_t DecRef() {
+        return --count_;
+    }
+
+    size_t RefCount() const {
+        return count_;
+    }
+
+private:
+    size_t count_;
+};
+
+// Counter for owners shared between threads
+class AtomicCounter {
+public:
+    explicit AtomicCounter(size_t count) : count_(count) {
+    }
+
+    // A new owner is always created from an existing one, so nothing has to be ordered here
+    size_t IncRef() {
+        return count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    // Every owner publishes its writes with release; the last one acquires them all with a single
+    // fence before the caller destroys anything
+    size_t DecRef() {
+        size_t count = count_.fetch_sub(1, std::memory_order_release) - 1;
+        if (count == 0) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return count;
+    }
+
+    size_t RefCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<size_t> count_;
+};
+
+template <typename T, typename Counter = AtomicCounter>
 class SharedPtr;
 
-template <typename T>
+template <typename T, typename Counter = AtomicCounter>
 class WeakPtr;
+
+template <typename T>
+using LocalSharedPtr = SharedPtr<T, LocalCounter>;
+
@@ -467,3 +467,70 @@ TEST_CASE("Destructor for correct type") {
         REQUIRE(B::destructor_called);
     }
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Local counts that remember how often they were touched
+class CountingCounter : public LocalCounter {
+public:
+    explicit CountingCounter(size_t count) : LocalCounter(count) {
+    }
+
+    size_t IncRef() {
+        ++increments;
+        return LocalCounter::IncRef();
+    }
+
+    size_t DecRef() {
+        ++decrements;
+        return LocalCounter::DecRef();
+    }
+
+    inline static int increments = 0;
+    inline static int decrements = 0;
+};
+
+struct CountedBase {
+    virtual ~CountedBase() = default;
+};
+
+struct Counted : CountedBase {};
+
+TEST_CASE("Moves leave the counts alone") {
+    auto sp = MakeShared<Counted, CountingCounter>();
+    auto other = MakeShared<Counted, CountingCounter>();
+    CountingCounter::increments = 0;
+    CountingCounter::decrements = 0;
+
+    SharedPtr<Counted, CountingCounter> moved = std::move(sp);
+    SharedPtr<CountedBase, CountingCounter> base = std::move(moved);
+    SharedPtr<CountedBase, CountingCounter> owner;
+    owner = std::move(base);
+    owner = std::move(owner);  // NOLINT
+    SharedPtr<CountedBase, CountingCounter> assigned;
+    assigned = std::move(other);
+
+    REQUIRE(CountingCounter::increments == 0);
+    REQUIRE(CountingCounter::decrements == 0);
+    REQUIRE(owner.UseCount() == 1);
+    REQUIRE(assigned.UseCount() == 1);
+    REQUIRE(!sp);
+    REQUIRE(!moved);
+    REQUIRE(!base);
+}
+
+TEST_CASE("Relocation") {
+    static_assert(std::is_nothrow_default_constructible_v<SharedPtr<int>>);
+    static_assert(std::is_nothrow_move_constructible_v<SharedPtr<int>>);
+    static_assert(noexcept(std::declval<SharedPtr<int>&>().Reset()));
+    static_assert(kIsTriviallyRelocatable<SharedPtr<int>>);
+
+    RelocatingVector<SharedPtr<int>> owners;
+    for (int i = 0; i < 100; ++i) {
+        owners.EmplaceBack(MakeShared<int>(i));
+    }
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(*owners[i] == i);
+        REQUIRE(owners[i].UseCount() == 1);
+    }
+}
@@ -0,0 +1,28 @@
+# Checks that `Forward` and `ForwardArray` from abi_check.cpp compile to register moves only
+#
+# cmake -DCOMPILER=<c++> -DSOURCE=<abi_check.cpp> -DINCLUDE=<repo root> [-DFLAGS=<flags>]
+#       -P abi_check.cmake
+
+execute_process(
+    COMMAND ${COMPILER} -std=c++20 -O2 ${FLAGS} -I${INCLUDE} -S -o - ${SOURCE}
+    OUTPUT_VARIABLE asm
+    ERROR_VARIABLE errors
+    RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "Compilation failed:\n${errors}")
+endif()
+
+foreach (function Forward ForwardArray)
+    string(LENGTH "${function}" length)
+    string(REGEX MATCH "\n_Z${length}${function}[^\n]*:\n.*" body "${asm}")
+    if (body STREQUAL "")
+        message(FATAL_ERROR "${function} is missing from the assembly")
+    endif()
+    # The body ends at the first return
+    string(FIND "${body}" "ret" end)
+    string(SUBSTRING "${body}" 0 ${end} body)
+    if (body MATCHES "\\(%")
+        message(FATAL_ERROR "${function} goes through memory:\n${body}")
+    endif()
+    message(STATUS "${function} passes UniquePtr in registers:\n${body}")
+endforeach()
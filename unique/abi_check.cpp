@@ -0,0 +1,19 @@
+// Compiled to assembly by abi_check.cmake: with `SMART_POINTERS_TRIVIAL_ABI` the functions below
+// must not touch memory to get at their `UniquePtr`s, which arrive and leave in registers
+
+#include "unique.h"
+
+UniquePtr<int> Forward(UniquePtr<int> ptr) {
+    return ptr;
+}
+
+UniquePtr<int[]> ForwardArray(UniquePtr<int[]> ptr) {
+    return ptr;
+}
+
+#if defined(__clang__) && defined(SMART_POINTERS_TRIVIAL_ABI)
+#if __has_builtin(__is_trivially_relocatable)
+static_assert(__is_trivially_relocatable(UniquePtr<int>));
+static_assert(__is_trivially_relocatable(UniquePtr<int[]>));
+#endif
+#endif
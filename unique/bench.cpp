@@ -0,0 +1,30 @@
+#include "unique.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// 256 MiB buffer that is filled right after it is made
+
+static constexpr size_t kBufferSize = size_t{256} << 20;
+
+static void BM_ValueInitialized(benchmark::State& state) {
+    for (auto _ : state) {
+        UniquePtr<char[]> buffer(new char[kBufferSize]());
+        std::memset(buffer.Get(), 1, kBufferSize);
+        benchmark::DoNotOptimize(buffer.Get());
+    }
+    state.SetBytesProcessed(state.iterations() * kBufferSize);
+}
+BENCHMARK(BM_ValueInitialized)->Unit(benchmark::kMillisecond);
+
+static void BM_ForOverwrite(benchmark::State& state) {
+    for (auto _ : state) {
+        auto buffer = MakeUniqueForOverwrite<char[]>(kBufferSize);
+        std::memset(buffer.Get(), 1, kBufferSize);
+        benchmark::DoNotOptimize(buffer.Get());
+    }
+    state.SetBytesProcessed(state.iterations() * kBufferSize);
+}
+BENCHMARK(BM_ForOverwrite)->Unit(benchmark::kMillisecond);
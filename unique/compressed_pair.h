@@ -1,152 +1,210 @@
 #pragma once
 
+#include <cstddef>
 #include <type_traits>
 #include <utility>
 
-template <typename F, typename S, bool = std::is_empty_v<F> && !std::is_final_v<F>,
-          bool = std::is_empty_v<S> && !std::is_final_v<S>>
-class CompressedPair;
+// Keeps the one-argument constructors from hijacking copies of the pair itself
+template <typename T, typename Pair>
+using EnableIfNotPair = std::enable_if_t<!std::is_same_v<std::decay_t<T>, Pair>>;
 
-template <typename F>
-class CompressedPair<F, F, true, true> : public F {
+// Same check for constructors that take any number of arguments
+template <typename Self, typename... Us>
+inline constexpr bool kIsCopyOf = false;
+
+template <typename Self, typename U>
+inline constexpr bool kIsCopyOf<Self, U> = std::is_same_v<std::decay_t<U>, Self>;
+
+// Asks an element to default-initialize its value, leaving trivial types indeterminate
+struct DefaultInit {};
+
+// Argument an element is made from
+template <typename U>
+struct ElementArg {
+    U&& value;
+};
+
+// Element `I` of a `CompressedTuple`
+//
+// Empty classes that are not final become a base and take no room; the index keeps two elements
+// of the same type apart. Everything else, final empty classes included, is a member.
+template <size_t I, typename T, bool = std::is_empty_v<T> && !std::is_final_v<T>>
+class CompressedElement {
 public:
-    CompressedPair() = default;
-    template <typename T, typename M>
-    CompressedPair(T&& first, M&& second) : T(std::forward<T>(first)), M(std::forward<M>(second)) {
+    constexpr CompressedElement() noexcept(std::is_nothrow_default_constructible_v<T>) : value_() {
     }
 
-    F& GetFirst() {
-        return static_cast<F&>(*this);
+    constexpr explicit CompressedElement(DefaultInit) noexcept(
+        std::is_nothrow_default_constructible_v<T>) {
     }
 
-    const F& GetFirst() const {
-        return static_cast<const F&>(*this);
+    template <typename U>
+    constexpr explicit CompressedElement(ElementArg<U> arg) noexcept(
+        std::is_nothrow_constructible_v<T, U&&>)
+        : value_(std::forward<U>(arg.value)) {
     }
 
-    F& GetSecond() {
-        return static_cast<F&>(*this);
+    constexpr T& Get() noexcept {
+        return value_;
     }
 
-    const F& GetSecond() const {
-        return static_cast<const F&>(*this);
+    constexpr const T& Get() const noexcept {
+        return value_;
     }
 
 private:
-    F first_;
+    T value_;
 };
 
-template <typename F, typename S>
-class CompressedPair<F, S, true, true> : F, S {
+template <size_t I, typename T>
+class CompressedElement<I, T, true> : T {
 public:
-    template <typename T, typename M>
-    CompressedPair(T&& first, M&& second) : F(std::forward<T>(first)), S(std::forward<M>(second)) {
+    constexpr CompressedElement() noexcept(std::is_nothrow_default_constructible_v<T>) : T() {
     }
 
-    F& GetFirst() {
-        return *this;
+    constexpr explicit CompressedElement(DefaultInit) noexcept(
+        std::is_nothrow_default_constructible_v<T>) {
     }
 
-    const F& GetFirst() const {
-        return *this;
+    template <typename U>
+    constexpr explicit CompressedElement(ElementArg<U> arg) noexcept(
+        std::is_nothrow_constructible_v<T, U&&>)
+        : T(std::forward<U>(arg.value)) {
     }
 
-    S& GetSecond() {
+    constexpr T& Get() noexcept {
         return *this;
     }
 
-    const S& GetSecond() const {
+    constexpr const T& Get() const noexcept {
         return *this;
     }
 };
 
-template <typename F, typename S>
-class CompressedPair<F, S, true, false> : F {
-public:
-    CompressedPair() : second_() {
-    }
-    template <typename T, typename M>
-    CompressedPair(T&& first, M&& second)
-        : F(std::forward<T>(first)), second_(std::forward<M>(second)) {
-    }
+template <typename Indices, typename... Ts>
+class CompressedTupleBase;
 
-    F& GetFirst() {
-        return static_cast<F&>(*this);
-    }
+template <size_t... Is, typename... Ts>
+class CompressedTupleBase<std::index_sequence<Is...>, Ts...> : public CompressedElement<Is, Ts>... {
+public:
+    // Value-initializes every element
+    constexpr CompressedTupleBase() = default;
 
-    const F& GetFirst() const {
-        return static_cast<const F&>(*this);
+    // The first `sizeof...(Us)` elements are made from `values`, the rest are default-initialized
+    template <typename... Us>
+    constexpr explicit CompressedTupleBase(DefaultInit, Us&&... values) noexcept(
+        (std::is_nothrow_constructible_v<CompressedElement<Is, Ts>,
+                                         decltype(Pick<Is>(std::declval<Us>()...))> &&
+         ...))
+        : CompressedElement<Is, Ts>(Pick<Is>(std::forward<Us>(values)...))... {
     }
 
-    S& GetSecond() {
-        return second_;
+    template <size_t I>
+    constexpr auto& Get() noexcept {
+        return GetElement<I>(*this).Get();
     }
 
-    const S& GetSecond() const {
-        return second_;
+    template <size_t I>
+    constexpr const auto& Get() const noexcept {
+        return GetElement<I>(*this).Get();
     }
 
 private:
-    S second_;
-};
-
-template <typename F, typename S>
-class CompressedPair<F, S, false, true> : S {
-public:
-    CompressedPair() : first_() {
-    }
-    template <typename T, typename M>
-    CompressedPair(T&& first, M&& second)
-        : S(std::forward<M>(second)), first_(std::forward<T>(first)) {
+    template <size_t I, typename U, typename... Us>
+    static constexpr decltype(auto) Nth(U&& value, Us&&... rest) noexcept {
+        if constexpr (I == 0) {
+            return std::forward<U>(value);
+        } else {
+            return Nth<I - 1>(std::forward<Us>(rest)...);
+        }
     }
 
-    F& GetFirst() {
-        return first_;
+    template <size_t I, typename... Us>
+    static constexpr auto Pick(Us&&... values) noexcept {
+        if constexpr (I < sizeof...(Us)) {
+            using U = decltype(Nth<I>(std::forward<Us>(values)...));
+            return ElementArg<U>{Nth<I>(std::forward<Us>(values)...)};
+        } else {
+            return DefaultInit();
+        }
     }
 
-    const F& GetFirst() const {
-        return first_;
+    // Deduces the type of element `I` from the base it lives in
+    template <size_t I, typename T, bool kEmpty>
+    static constexpr CompressedElement<I, T, kEmpty>& GetElement(
+        CompressedElement<I, T, kEmpty>& element) noexcept {
+        return element;
     }
 
-    S& GetSecond() {
-        return static_cast<S&>(*this);
+    template <size_t I, typename T, bool kEmpty>
+    static constexpr const CompressedElement<I, T, kEmpty>& GetElement(
+        const CompressedElement<I, T, kEmpty>& element) noexcept {
+        return element;
     }
+};
 
-    const S& GetSecond() const {
-        return static_cast<const S&>(*this);
+// Tuple that stores empty elements for free
+//
+// `Get<I>()` returns element `I`. Two elements of the same empty type still take a byte each, as
+// the language requires.
+template <typename... Ts>
+class CompressedTuple : public CompressedTupleBase<std::index_sequence_for<Ts...>, Ts...> {
+    using Base = CompressedTupleBase<std::index_sequence_for<Ts...>, Ts...>;
+
+public:
+    constexpr CompressedTuple() = default;
+
+    template <typename... Us, typename = std::enable_if_t<sizeof...(Us) == sizeof...(Ts) &&
+                                                          !kIsCopyOf<CompressedTuple, Us...>>>
+    constexpr CompressedTuple(Us&&... values) noexcept(
+        std::is_nothrow_constructible_v<Base, DefaultInit, Us&&...>)
+        : Base(DefaultInit(), std::forward<Us>(values)...) {
     }
 
-private:
-    F first_;
+    // Default-initializes the elements left without a value
+    template <typename... Us, typename = std::enable_if_t<0 < sizeof...(Us) &&
+                                                          sizeof...(Us) < sizeof...(Ts) &&
+                                                          !kIsCopyOf<CompressedTuple, Us...>>,
+              typename = void>
+    constexpr explicit CompressedTuple(Us&&... values) noexcept(
+        std::is_nothrow_constructible_v<Base, DefaultInit, Us&&...>)
+        : Base(DefaultInit(), std::forward<Us>(values)...) {
+    }
 };
 
 template <typename F, typename S>
-class CompressedPair<F, S, false, false> {
+class CompressedPair : public CompressedTuple<F, S> {
+    using Base = CompressedTuple<F, S>;
+
 public:
-    CompressedPair() : first_(), second_() {
+    constexpr CompressedPair() = default;
+
+    // Leaves `second` default-initialized
+    template <typename T, typename = EnableIfNotPair<T, CompressedPair>>
+    constexpr explicit CompressedPair(T&& first) noexcept(
+        std::is_nothrow_constructible_v<Base, T&&>)
+        : Base(std::forward<T>(first)) {
     }
 
     template <typename T, typename M>
-    CompressedPair(T&& first, M&& second)
-        : first_(std::forward<T>(first)), second_(std::forward<M>(second)) {
+    constexpr CompressedPair(T&& first, M&& second) noexcept(
+        std::is_nothrow_constructible_v<Base, T&&, M&&>)
+        : Base(std::forward<T>(first), std::forward<M>(second)) {
     }
 
-    F& GetFirst() {
-        return first_;
+    constexpr F& GetFirst() noexcept {
+        return this->template Get<0>();
     }
 
-    const F& GetFirst() const {
-        return first_;
+    constexpr const F& GetFirst() const noexcept {
+        return this->template Get<0>();
     }
 
-    S& GetSecond() {
-        return second_;
+    constexpr S& GetSecond() noexcept {
+        return this->template Get<1>();
     }
 
-    const S& GetSecond() const {
-        return second_;
+    constexpr const S& GetSecond() const noexcept {
+        return this->template Get<1>();
     }
-
-private:
-    F first_;
-    S second_;
-};
\ No newline at end of file
+};
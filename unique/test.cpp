@@ -5,6 +5,7 @@
 #include <common/my_int.h>
 
 #include <catch.hpp>
+#include <functional>
 #include <vector>
 #include <tuple>
 
@@ -466,6 +467,55 @@ TEST_CASE("Compressed pair usage") {
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
+struct Empty {};
+struct OtherEmpty {};
+struct FinalEmpty final {};
+
+constexpr int SumOfTuple() {
+    CompressedTuple<int, Empty, long> tuple(1, Empty(), 2L);
+    tuple.Get<0>() += 10;
+    return tuple.Get<0>() + static_cast<int>(tuple.Get<2>());
+}
+
+TEST_CASE("Compressed tuple") {
+    SECTION("Empty elements are free") {
+        static_assert(sizeof(CompressedTuple<int*, Empty, OtherEmpty>) == sizeof(int*));
+        static_assert(sizeof(CompressedTuple<Empty, int*, OtherEmpty>) == sizeof(int*));
+        static_assert(sizeof(CompressedPair<Empty, Empty>) == 2);
+        static_assert(sizeof(CompressedPair<int*, FinalEmpty>) ==
+                      sizeof(std::pair<int*, FinalEmpty>));
+    }
+
+    SECTION("Constexpr and noexcept") {
+        static_assert(SumOfTuple() == 13);
+        static_assert(std::is_nothrow_default_constructible_v<CompressedTuple<int, Empty>>);
+        static_assert(std::is_nothrow_constructible_v<CompressedTuple<int, Empty>, int, Empty>);
+        static_assert(!std::is_nothrow_constructible_v<CompressedTuple<std::vector<int>, Empty>,
+                                                       std::initializer_list<int>, Empty>);
+        static_assert(noexcept(std::declval<CompressedTuple<int, Empty>&>().Get<1>()));
+    }
+
+    SECTION("Elements") {
+        CompressedTuple<UniquePtr<int>, Empty, std::vector<int>> tuple(UniquePtr<int>(new int(5)));
+        REQUIRE(*tuple.Get<0>() == 5);
+        REQUIRE(tuple.Get<2>().empty());
+
+        auto moved = std::move(tuple);
+        REQUIRE(*moved.Get<0>() == 5);
+        REQUIRE(!tuple.Get<0>());
+
+        int value = 0;
+        CompressedTuple<int&, Empty> ref(value, Empty());
+        ref.Get<0>() = 7;
+        REQUIRE(value == 7);
+
+        CompressedPair<Empty, Empty> pair;
+        REQUIRE(&pair.GetFirst() != static_cast<void*>(&pair.GetSecond()));
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
 template <typename T>
 class DerivedDeleter : public Deleter<T> {};
 
@@ -504,3 +554,72 @@ TEST_CASE("Upcasts") {
         s2 = std::move(s);
     }
 }
+
+TEST_CASE("MakeUniqueForOverwrite") {
+    SECTION("Single object") {
+        auto ptr = MakeUniqueForOverwrite<int>();
+        *ptr = 42;
+        REQUIRE(*ptr == 42);
+
+        auto str = MakeUniqueForOverwrite<std::vector<int>>();
+        REQUIRE(str->empty());
+    }
+
+    SECTION("Array") {
+        auto buffer = MakeUniqueForOverwrite<int[]>(1000);
+        static_assert(std::is_same_v<decltype(buffer), UniquePtr<int[]>>);
+        for (int i = 0; i < 1000; ++i) {
+            buffer[i] = i;
+        }
+        REQUIRE(buffer[999] == 999);
+
+        auto vectors = MakeUniqueForOverwrite<std::vector<int>[]>(3);
+        REQUIRE(vectors[2].empty());
+    }
+}
+
+TEST_CASE("Relocation") {
+    static_assert(std::is_nothrow_move_constructible_v<UniquePtr<int>>);
+    static_assert(std::is_nothrow_move_assignable_v<UniquePtr<int>>);
+    static_assert(std::is_nothrow_move_constructible_v<UniquePtr<int[]>>);
+    static_assert(kIsTriviallyRelocatable<UniquePtr<int>>);
+    static_assert(kIsTriviallyRelocatable<UniquePtr<int[]>>);
+    static_assert(kIsTriviallyRelocatable<UniquePtr<int, void (*)(int*)>>);
+    static_assert(!kIsTriviallyRelocatable<UniquePtr<int, std::function<void(int*)>>>);
+
+    RelocatingVector<UniquePtr<int>> ptrs;
+    for (int i = 0; i < 100; ++i) {
+        ptrs.EmplaceBack(new int(i));
+    }
+    for (int i = 0; i < 100; ++i) {
+        REQUIRE(*ptrs[i] == i);
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+int released_handles = 0;
+
+void ReleaseHandle(int* handle) noexcept {
+    ++released_handles;
+    delete handle;
+}
+
+TEST_CASE("Function deleters") {
+    using Handle = UniquePtr<int, FnDeleter<&ReleaseHandle>>;
+    static_assert(sizeof(Handle) == sizeof(int*));
+    static_assert(std::is_empty_v<FnDeleter<&ReleaseHandle>>);
+    static_assert(std::is_nothrow_invocable_v<FnDeleter<&ReleaseHandle>, int*>);
+    static_assert(kIsTriviallyRelocatable<Handle>);
+
+    released_handles = 0;
+    {
+        Handle handle(new int(1));
+        Handle other(std::move(handle));
+        other.Reset(new int(2));
+        REQUIRE(released_handles == 1);
+
+        Handle empty;
+    }
+    REQUIRE(released_handles == 2);
+}
@@ -2,7 +2,10 @@
 
 #include "compressed_pair.h"
 
+#include <common/relocation.h>
+
 #include <cstddef>  // std::nullptr_t
+#include <type_traits>
 
 template <class T>
 struct Slug {
@@ -36,14 +39,40 @@ struct Slug<T[]> {
     }
 };
 
+// Deleter that calls the function `kFn`, such as `std::fclose` or a pool release
+//
+// The function is part of the type, so the deleter is empty and `UniquePtr` stays one pointer
+// wide, unlike with a function pointer deleter. The call is direct and can be inlined.
+template <auto kFn>
+struct FnDeleter {
+    template <typename T>
+    void operator()(T* p) const noexcept(noexcept(kFn(p))) {
+        kFn(p);
+    }
+};
+
+// Builds with `SMART_POINTERS_TRIVIAL_ABI` ask Clang to pass `UniquePtr` by value in registers,
+// as if it were a raw pointer. The callee then destroys such parameters itself, so the object
+// dies at the end of the called function rather than after the full expression of the caller.
+// Clang ignores the attribute for deleters that are not trivially copyable; other compilers
+// ignore the flag.
+#if defined(SMART_POINTERS_TRIVIAL_ABI) && defined(__has_cpp_attribute)
+#if __has_cpp_attribute(clang::trivial_abi)
+#define UNIQUE_PTR_TRIVIAL_ABI [[clang::trivial_abi]]
+#endif
+#endif
+#ifndef UNIQUE_PTR_TRIVIAL_ABI
+#define UNIQUE_PTR_TRIVIAL_ABI
+#endif
+
 // Primary template
 template <typename T, typename Deleter = Slug<T>>
-class UniquePtr {
+class UNIQUE_PTR_TRIVIAL_ABI UniquePtr {
 public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
-    explicit UniquePtr(T* ptr = nullptr) {
+    explicit UniquePtr(T* ptr = nullptr) noexcept {
         pair_.GetFirst() = ptr;
     }
     UniquePtr(T* ptr, Deleter deleter) {
@@ -51,6 +80,12 @@ public:
         pair_.GetSecond() = std::forward<Deleter>(deleter);
     }
 
+    // A template is never a move constructor, and `trivial_abi` needs one
+    UniquePtr(UniquePtr&& other) noexcept {
+        pair_.GetFirst() = other.Release();
+        pair_.GetSecond() = std::forward<Deleter>(other.GetDeleter());
+    }
+
     template <class U, class V>
     UniquePtr(UniquePtr<U, V>&& other) noexcept {
         pair_.GetFirst() = other.Release();
@@ -86,7 +121,7 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
 
-    T* Release() {
+    T* Release() noexcept {
         T* el = pair_.GetFirst();
         pair_.GetFirst() = nullptr;
         return el;
@@ -134,12 +169,12 @@ private:
 
 // Specialization for arrays
 template <typename T, typename Deleter>
-class UniquePtr<T[], Deleter> {
+class UNIQUE_PTR_TRIVIAL_ABI UniquePtr<T[], Deleter> {
 public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
-    explicit UniquePtr(T* ptr = nullptr) {
+    explicit UniquePtr(T* ptr = nullptr) noexcept {
         pair_.GetFirst() = ptr;
     }
     UniquePtr(T* ptr, Deleter deleter) {
@@ -147,6 +182,12 @@ public:
         pair_.GetSecond() = std::forward<Deleter>(deleter);
     }
 
+    // A template is never a move constructor, and `trivial_abi` needs one
+    UniquePtr(UniquePtr&& other) noexcept {
+        pair_.GetFirst() = other.Release();
+        pair_.GetSecond() = std::forward<Deleter>(other.GetDeleter());
+    }
+
     template <class U, class V>
     UniquePtr(UniquePtr<U, V>&& other) noexcept {
         pair_.GetFirst() = other.Release();
@@ -182,7 +223,7 @@ public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
 
-    T* Release() {
+    T* Release() noexcept {
         T* el = pair_.GetFirst();
         pair_.GetFirst() = nullptr;
         return el;
@@ -230,3 +271,19 @@ public:
 private:
     CompressedPair<T*, Deleter> pair_;
 };
+
+// Only the pointer and the deleter are stored
+template <typename T, typename Deleter>
+struct IsTriviallyRelocatable<UniquePtr<T, Deleter>> : IsTriviallyRelocatable<Deleter> {};
+
+// Default-initialize instead of value-initializing: trivial objects and array elements are left
+// indeterminate, for storage that is about to be overwritten anyway
+template <typename T>
+std::enable_if_t<!std::is_array_v<T>, UniquePtr<T>> MakeUniqueForOverwrite() {
+    return UniquePtr<T>(new T);
+}
+
+template <typename T>
+std::enable_if_t<std::is_unbounded_array_v<T>, UniquePtr<T>> MakeUniqueForOverwrite(size_t size) {
+    return UniquePtr<T>(new std::remove_extent_t<T>[size]);
+}
@@ -1,83 +1,218 @@
 #pragma once
 
+#include <common/relocation.h>
+
+#include <atomic>
+#include <cstddef>
 #include <exception>
+#include <type_traits>
 
 class BadWeakPtr : public std::exception {};
 
-template <typename T>
+// Counter for object graphs that never leave one thread
+class LocalCounter {
+public:
+    explicit LocalCounter(size_t count) : count_(count) {
+    }
+
+    size_t IncRef() {
+        return ++count_;
+    }
+
+    size_t DecRef() {
+        return --count_;
+    }
+
+    bool TryIncRef() {
+        if (count_ == 0) {
+            return false;
+        }
+        ++count_;
+        return true;
+    }
+
+    size_t RefCount() const {
+        return count_;
+    }
+
+    bool IsUnique() const {
+        return count_ == 1;
+    }
+
+private:
+    size_t count_;
+};
+
+// Counter for owners shared between threads
+class AtomicCounter {
+public:
+    explicit AtomicCounter(size_t count) : count_(count) {
+    }
+
+    // A new owner is always created from an existing one, so nothing has to be ordered here
+    size_t IncRef() {
+        return count_.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+
+    // Every owner publishes its writes with release; the last one acquires them all with a single
+    // fence before the caller destroys anything
+    size_t DecRef() {
+        size_t count = count_.fetch_sub(1, std::memory_order_release) - 1;
+        if (count == 0) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+        }
+        return count;
+    }
+
+    // Increments unless the counter has already dropped to zero
+    bool TryIncRef() {
+        size_t count = count_.load(std::memory_order_relaxed);
+        do {
+            if (count == 0) {
+                return false;
+            }
+        } while (!count_.compare_exchange_weak(count, count + 1, std::memory_order_acquire,
+                                               std::memory_order_relaxed));
+        return true;
+    }
+
+    size_t RefCount() const {
+        return count_.load(std::memory_order_relaxed);
+    }
+
+    // Acquires the decrements of the other holders, so the caller may free what they used
+    bool IsUnique() const {
+        return count_.load(std::memory_order_acquire) == 1;
+    }
+
+private:
+    std::atomic<size_t> count_;
+};
+
+template <typename T, typename Counter = AtomicCounter>
 class SharedPtr;
 
-template <typename T>
+template <typename T, typename Counter = AtomicCounter>
 class WeakPtr;
 
+template <typename T>
+using LocalSharedPtr = SharedPtr<T, LocalCounter>;
+
+template <typename T>
+using LocalWeakPtr = WeakPtr<T, LocalCounter>;
+
+// Control blocks have no vtable: the concrete block passes one manager function to the base, and
+// the base calls it to destroy the object, to free the block or to do both at once
+template <typename Counter>
 struct ControlBlockBase {
+    enum class Op { kDestroyObject, kFreeBlock, kDestroyAndFree };
+    using Manager = void (*)(ControlBlockBase*, Op);
+
+    explicit ControlBlockBase(Manager manager) : manager_(manager) {
+    }
+
     size_t GetRefCount() const {
-        return ref_counter_;
+        return ref_counter_.RefCount();
     }
 
-    size_t GetRefWCount() {
-        return weak_ref_counter_;
+    // Strong owners hold one weak reference between them, so this is one more than the number of
+    // `WeakPtr`s while the object is alive
+    size_t GetRefWCount() const {
+        return weak_ref_counter_.RefCount();
     }
 
     void AddRef() {
-        ++ref_counter_;
+        ref_counter_.IncRef();
+    }
+
+    // Promotes a weak reference; fails if the object is already destroyed
+    bool TryAddRef() {
+        return ref_counter_.TryIncRef();
     }
 
     void RemRef() {
-        --ref_counter_;
+        if (ref_counter_.DecRef() == 0) {
+            // New weak references are made only from existing ones, so if the owners' reference is
+            // the last one nobody can touch the block any more
+            if (weak_ref_counter_.IsUnique()) {
+                manager_(this, Op::kDestroyAndFree);
+            } else {
+                DefDeleter();
+                RemRefW();
+            }
+        }
     }
 
     void AddRefW() {
-        ++weak_ref_counter_;
+        weak_ref_counter_.IncRef();
     }
 
     void RemRefW() {
-        --weak_ref_counter_;
+        if (weak_ref_counter_.DecRef() == 0) {
+            manager_(this, Op::kFreeBlock);
+        }
     }
 
-    virtual void DefDeleter() {
-    }
-    virtual ~ControlBlockBase() {
+    void DefDeleter() {
+        manager_(this, Op::kDestroyObject);
     }
 
 protected:
-    size_t ref_counter_ = 1;
-    size_t weak_ref_counter_ = 0;
+    // Blocks are freed only by their manager, which knows the concrete type
+    ~ControlBlockBase() = default;
+
+    Manager manager_;
+    Counter ref_counter_{1};
+    Counter weak_ref_counter_{1};
 };
 
-template <typename T>
-struct ControlBlockUs : ControlBlockBase {
-    ControlBlockUs(T* ptr) {
-        ptr_ = ptr;
-        ref_counter_ = 1;
-    }
+template <typename T, typename Counter>
+struct ControlBlockUs : ControlBlockBase<Counter> {
+    using Op = typename ControlBlockBase<Counter>::Op;
 
-    ~ControlBlockUs() override {
+    ControlBlockUs(T* ptr) : ControlBlockBase<Counter>(&Manage) {
+        ptr_ = ptr;
     }
 
-    void DefDeleter() override {
-        delete ptr_;
+private:
+    static void Manage(ControlBlockBase<Counter>* base, Op op) {
+        auto* self = static_cast<ControlBlockUs*>(base);
+        if (op != Op::kFreeBlock) {
+            delete self->ptr_;
+        }
+        if (op != Op::kDestroyObject) {
+            delete self;
+        }
     }
 
-private:
     T* ptr_;
 };
 
-template <typename T>
-struct ControlBlockMS : ControlBlockBase {
+template <typename T, typename Counter>
+struct ControlBlockMS : ControlBlockBase<Counter> {
+    using Op = typename ControlBlockBase<Counter>::Op;
+
     template <typename... Arg>
-    ControlBlockMS(Arg&&... args) {
+    ControlBlockMS(Arg&&... args) : ControlBlockBase<Counter>(&Manage) {
         new (&storage_) T(std::forward<Arg>(args)...);
     }
     T* GetPtr() {
         return reinterpret_cast<T*>(&storage_);
     }
-    ~ControlBlockMS() override {
-    }
-    void DefDeleter() override {
-        GetPtr()->~T();
-    }
 
 private:
+    static void Manage(ControlBlockBase<Counter>* base, Op op) {
+        auto* self = static_cast<ControlBlockMS*>(base);
+        // Trivial objects need no destruction, so both releases only free the block
+        if constexpr (!std::is_trivially_destructible_v<T>) {
+            if (op != Op::kFreeBlock) {
+                self->GetPtr()->~T();
+            }
+        }
+        if (op != Op::kDestroyObject) {
+            delete self;
+        }
+    }
+
     std::aligned_storage_t<sizeof(T), alignof(T)> storage_;
 };
@@ -147,6 +147,24 @@ TEST_CASE("Shared from invalid Weak") {
     REQUIRE_THROWS_AS(SharedPtr<int>(w_ptr), BadWeakPtr);
 }
 
+TEST_CASE("TryLock") {
+    WeakPtr<int> empty;
+    static_assert(noexcept(empty.TryLock()));
+    REQUIRE(empty.TryLock().Get() == nullptr);
+    REQUIRE_THROWS_AS(SharedPtr<int>(empty), BadWeakPtr);
+
+    WeakPtr<int> weak;
+    {
+        auto sp = MakeShared<int>(42);
+        weak = sp;
+        auto locked = weak.TryLock();
+        REQUIRE(*locked == 42);
+        REQUIRE(sp.UseCount() == 2);
+    }
+    REQUIRE(weak.TryLock().Get() == nullptr);
+    REQUIRE(weak.UseCount() == 0);
+}
+
 TEST_CASE("Constness") {
     SharedPtr<int> sp(new int(42));
     WeakPtr<const int> wp(sp);
@@ -175,3 +193,82 @@ TEST_CASE("Lifetimes") {
         delete wp;
     }
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Local counts that remember how often they were touched
+class CountingCounter : public LocalCounter {
+public:
+    explicit CountingCounter(size_t count) : LocalCounter(count) {
+    }
+
+    size_t IncRef() {
+        ++increments;
+        return LocalCounter::IncRef();
+    }
+
+    size_t DecRef() {
+        ++decrements;
+        return LocalCounter::DecRef();
+    }
+
+    inline static int increments = 0;
+    inline static int decrements = 0;
+};
+
+struct CountedBase {
+    virtual ~CountedBase() = default;
+};
+
+struct Counted : CountedBase {};
+
+TEST_CASE("Moves leave the counts alone") {
+    auto sp = MakeShared<Counted, CountingCounter>();
+    auto other = MakeShared<Counted, CountingCounter>();
+    WeakPtr<Counted, CountingCounter> weak = sp;
+    CountingCounter::increments = 0;
+    CountingCounter::decrements = 0;
+
+    SharedPtr<Counted, CountingCounter> moved = std::move(sp);
+    SharedPtr<CountedBase, CountingCounter> base = std::move(moved);
+    SharedPtr<CountedBase, CountingCounter> owner;
+    owner = std::move(base);
+    owner = std::move(owner);  // NOLINT
+    SharedPtr<CountedBase, CountingCounter> assigned;
+    assigned = std::move(other);
+
+    WeakPtr<Counted, CountingCounter> weak_moved = std::move(weak);
+    WeakPtr<CountedBase, CountingCounter> weak_base = std::move(weak_moved);
+    WeakPtr<CountedBase, CountingCounter> weak_assigned;
+    weak_assigned = std::move(weak_base);
+
+    REQUIRE(CountingCounter::increments == 0);
+    REQUIRE(CountingCounter::decrements == 0);
+    REQUIRE(owner.UseCount() == 1);
+    REQUIRE(assigned.UseCount() == 1);
+    REQUIRE(weak_assigned.Lock().Get() == owner.Get());
+    REQUIRE(!sp);
+    REQUIRE(!moved);
+    REQUIRE(!base);
+    REQUIRE(weak.Expired());
+    REQUIRE(weak_base.Expired());
+}
+
+TEST_CASE("Relocation") {
+    static_assert(std::is_nothrow_default_constructible_v<WeakPtr<int>>);
+    static_assert(std::is_nothrow_move_constructible_v<WeakPtr<int>>);
+    static_assert(noexcept(std::declval<WeakPtr<int>&>().Reset()));
+    static_assert(kIsTriviallyRelocatable<SharedPtr<int>>);
+    static_assert(kIsTriviallyRelocatable<WeakPtr<int>>);
+
+    auto sp = MakeShared<int>(42);
+    RelocatingVector<WeakPtr<int>> observers;
+    for (int i = 0; i < 100; ++i) {
+        observers.EmplaceBack(sp);
+    }
+    for (auto& observer : observers) {
+        REQUIRE(*observer.Lock() == 42);
+    }
+    sp.Reset();
+    REQUIRE(observers[99].Expired());
+}
@@ -2,28 +2,31 @@
 
 #include "sw_fwd.h"  // Forward declaration
 
+#include <utility>
+
 // https://en.cppreference.com/w/cpp/memory/weak_ptr
-template <typename T>
+template <typename T, typename Counter>
 class WeakPtr {
 public:
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Constructors
 
-    WeakPtr() : data_(nullptr), ptr_(nullptr) {
+    WeakPtr() noexcept : data_(nullptr), ptr_(nullptr) {
     }
 
     WeakPtr(const WeakPtr& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
         CheckAdd();
     }
+    // Moves take the reference over and leave the counts alone
     template <typename P>
-    WeakPtr(WeakPtr<P>&& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
-        CheckAdd();
-        other.Reset();
+    WeakPtr(WeakPtr<P, Counter>&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), ptr_(std::exchange(other.ptr_, nullptr)) {
     }
 
     // Demote `SharedPtr`
     // #2 from https://en.cppreference.com/w/cpp/memory/weak_ptr/weak_ptr
-    WeakPtr(const SharedPtr<T>& other) noexcept : data_(other.GetBlock()), ptr_(other.Get()) {
+    WeakPtr(const SharedPtr<T, Counter>& other) noexcept
+        : data_(other.GetBlock()), ptr_(other.Get()) {
         CheckAdd();
     }
 
@@ -38,12 +41,9 @@ public:
         return *this;
     }
 
-    WeakPtr& operator=(WeakPtr&& other) noexcept {
-        DelChecking();
-        data_ = other.GetBlock();
-        ptr_ = other.Get();
-        CheckAdd();
-        other.Reset();
+    template <typename P>
+    WeakPtr& operator=(WeakPtr<P, Counter>&& other) noexcept {
+        WeakPtr(std::move(other)).Swap(*this);
         return *this;
     }
 
@@ -51,23 +51,18 @@ public:
     // Destructor
 
     ~WeakPtr() {
-        if (data_ != nullptr) {
-            data_->RemRefW();
-            if (data_->GetRefCount() == 0 && data_->GetRefWCount() == 0) {
-                delete data_;
-            }
-        }
+        DelChecking();
     }
 
     ////////////////////////////////////////////////////////////////////////////////////////////////
     // Modifiers
 
-    void Reset() {
+    void Reset() noexcept {
         DelChecking();
         data_ = nullptr;
         ptr_ = nullptr;
     }
-    void Swap(WeakPtr& other) {
+    void Swap(WeakPtr& other) noexcept {
         std::swap(data_, other.data_);
         std::swap(ptr_, other.ptr_);
     }
@@ -78,9 +73,6 @@ public:
     void DelChecking() {
         if (data_ != nullptr) {
             data_->RemRefW();
-            if (data_->GetRefCount() == 0 && data_->GetRefWCount() == 0) {
-                delete data_;
-            }
         }
     }
 
@@ -92,7 +84,7 @@ public:
     T* Get() const {
         return ptr_;
     }
-    ControlBlockBase* GetBlock() const {
+    ControlBlockBase<Counter>* GetBlock() const {
         return data_;
     }
     T& operator*() const {
@@ -107,11 +99,24 @@ public:
     bool Expired() const {
         return (data_ == nullptr) ? true : (data_->GetRefCount() == 0);
     }
-    SharedPtr<T> Lock() const {
-        return Expired() ? SharedPtr<T>() : SharedPtr<T>(*this);
+    // Upgrades with a single increment-if-nonzero, so it cannot race with the last owner
+    SharedPtr<T, Counter> TryLock() const noexcept {
+        if (data_ != nullptr && data_->TryAddRef()) {
+            return SharedPtr<T, Counter>(data_, ptr_);
+        }
+        return SharedPtr<T, Counter>();
+    }
+    SharedPtr<T, Counter> Lock() const noexcept {
+        return TryLock();
     }
 
 private:
-    ControlBlockBase* data_ = nullptr;
+    template <typename U, typename C>
+    friend class WeakPtr;
+
+    ControlBlockBase<Counter>* data_ = nullptr;
     T* ptr_ = nullptr;
 };
+
+template <typename T, typename Counter>
+struct IsTriviallyRelocatable<WeakPtr<T, Counter>> : std::true_type {};